@@ -8,10 +8,29 @@ g++ -g\
     src/big_int_math.cpp\
     src/big_int_io.cpp\
     src/big_int_private.cpp\
+    src/big_int_long.cpp\
     src/sieve.cpp\
     src/sieve_startup.cpp\
     src/sieve_numtheo.cpp\
-    src/gf2solver/space_contributions.cpp\
+    src/sieve_pipeline.cpp\
+    src/sieve_batch.cpp\
+    src/sieve_relations.cpp\
+    src/sieve_log.cpp\
+    src/sieve_network.cpp\
+    src/sieve_autotune.cpp\
+    src/threshold_controller.cpp\
+    src/cofactor/is_prime.cpp\
+    src/cofactor/pollard_rho.cpp\
+    src/cofactor/squfof.cpp\
+    src/cofactor/split.cpp\
     src/gf2solver/basis_contributions.cpp\
-    src/gf2solver/gaussian.cpp -o jans
+    src/gf2solver/singletons.cpp\
+    src/gf2solver/filter.cpp\
+    src/gf2solver/gaussian.cpp\
+    src/gf2solver/dense_storage.cpp\
+    src/gf2solver/structured_gaussian.cpp\
+    src/gf2solver/sparse_matrix.cpp\
+    src/gf2solver/blocks.cpp\
+    src/gf2solver/lanczos.cpp\
+    src/gf2solver/wiedemann.cpp -o jans
 
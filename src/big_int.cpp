@@ -50,6 +50,12 @@ jans::big_int::big_int(const big_int& tocopy)
     __copy__(data, tocopy.data);
 }
 
+jans::big_int& jans::big_int::operator=(const big_int& tocopy)
+{
+    copy(tocopy);
+    return *this;
+}
+
 void jans::big_int::copy(const big_int& tocopy){
 
    lead = tocopy.lead;
@@ -254,6 +260,19 @@ long double jans::big_int::i2f( big_int & x ){
 
 }
 
+bool jans::big_int::i2u( big_int & x, ucarry_t & value ){
+
+   const int blocks = sizeof( ucarry_t ) / sizeof( ubase_t );
+   if ( x.lead > blocks ){ return false; }
+
+   value = 0;
+   for ( int i = x.lead - 1; i >= 0; i-- ){
+      value = ( value << BLOCK_BIT ) | x.data[ i ];
+   }
+   return true;
+
+}
+
 void jans::big_int::f2i( big_int & x, const long double number ){
 
    long double remainder = number;
@@ -21,6 +21,7 @@
 #define JANS_BIG_INT
 
 #include <string>
+#include <vector>
 #include <limits.h>
 
 #define ubase_t  unsigned int
@@ -43,6 +44,8 @@ namespace jans{
 
          virtual ~big_int();
 
+         big_int & operator=(const big_int & tocopy);
+
          void copy(const big_int & tocopy);
 
          void copy( const ubase_t value );
@@ -65,6 +68,8 @@ namespace jans{
 
          static void f2i( big_int & x, const long double number );
 
+         static bool i2u( big_int & x, ucarry_t & value ); // Returns false if x does not fit in ucarry_t
+
          // Basic operations
 
          static bool equal( big_int & n1, big_int & n2 ); // ( n1 == n2 )
@@ -117,6 +122,16 @@ namespace jans{
 
          static bool miller_rabin( big_int & n, const ubase_t attempts );
 
+         // Long numbers (not limited by NUM_BLOCK)
+
+         static void to_long( std::vector<ubase_t> & res, big_int & x );
+
+         static void from_long( big_int & x, const std::vector<ubase_t> & value );
+
+         static void long_prod( std::vector<ubase_t> & res, const std::vector<ubase_t> & a, const std::vector<ubase_t> & b );
+
+         static void long_mod( std::vector<ubase_t> & rem, const std::vector<ubase_t> & n, const std::vector<ubase_t> & d );
+
       private:
 
          ubase_t * data;
@@ -182,6 +197,9 @@ namespace jans{
          // Solves for d = ceil( sqrt( num ) )
          static int __ceil_sqrt__( ubase_t * d, const int ld, ubase_t * num, const int ln );
 
+         // r[ 0 : la + lb ] = a * b for long numbers (Karatsuba)
+         static void __long_mult__( ubase_t * r, const ubase_t * a, const int la, const ubase_t * b, const int lb );
+
    };
 
 }
@@ -0,0 +1,237 @@
+/*
+   JANS: just another number sieve
+   Copyright (C) 2018 Sebastian Wouters
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+#include <assert.h>
+
+#include "big_int.h"
+
+/*
+    Long numbers: little-endian blocks in a std::vector<ubase_t> without leading zero blocks, not limited by NUM_BLOCK.
+    They serve the product and remainder trees of the batch smoothness test.
+*/
+
+#define KARATSUBA_CUTOFF 32 // Schoolbook multiplication below this number of blocks
+
+void jans::big_int::to_long( std::vector<ubase_t> & res, big_int & x ){
+
+   res.assign( x.data, x.data + x.lead );
+
+}
+
+void jans::big_int::from_long( big_int & x, const std::vector<ubase_t> & value ){
+
+   assert( ( int )( value.size() ) <= NUM_BLOCK );
+   __clear__( x.data );
+   for ( size_t i = 0; i < value.size(); i++ ){ x.data[ i ] = value[ i ]; }
+   x.lead = value.size();
+
+}
+
+void jans::big_int::long_prod( std::vector<ubase_t> & res, const std::vector<ubase_t> & a, const std::vector<ubase_t> & b ){
+
+   if ( ( a.size() == 0 ) || ( b.size() == 0 ) ){ res.clear(); return; }
+   std::vector<ubase_t> temp( a.size() + b.size(), 0 );
+   __long_mult__( temp.data(), a.data(), a.size(), b.data(), b.size() );
+   while ( ( temp.size() > 0 ) && ( temp.back() == 0 ) ){ temp.pop_back(); }
+   res.swap( temp );
+
+}
+
+void jans::big_int::long_mod( std::vector<ubase_t> & rem, const std::vector<ubase_t> & n, const std::vector<ubase_t> & d ){
+
+   // Knuth, TAOCP Vol. 2, Algorithm 4.3.1 D; only the remainder is kept
+
+   const int ln = n.size();
+   const int ld = d.size();
+   assert( ld > 0 );
+
+   if ( ln < ld ){ rem = n; return; }
+
+   if ( ld == 1 ){
+      ucarry_t r = 0;
+      for ( int i = ln - 1; i >= 0; i-- ){ r = ( ( r << BLOCK_BIT ) + n[ i ] ) % d[ 0 ]; }
+      rem.clear();
+      if ( r != 0 ){ rem.push_back( r ); }
+      return;
+   }
+
+   // Normalize: shift so that the leading block of d has its top bit set
+   int s = 0;
+   while ( ( ( d[ ld - 1 ] << s ) >> ( BLOCK_BIT - 1 ) ) == 0 ){ s++; }
+
+   std::vector<ubase_t> vn( ld );
+   std::vector<ubase_t> un( ln + 1 );
+   for ( int i = ld - 1; i > 0; i-- ){
+      vn[ i ] = ( d[ i ] << s ) | ( ( s == 0 ) ? 0 : ( d[ i - 1 ] >> ( BLOCK_BIT - s ) ) );
+   }
+   vn[ 0 ] = d[ 0 ] << s;
+   un[ ln ] = ( ( s == 0 ) ? 0 : ( n[ ln - 1 ] >> ( BLOCK_BIT - s ) ) );
+   for ( int i = ln - 1; i > 0; i-- ){
+      un[ i ] = ( n[ i ] << s ) | ( ( s == 0 ) ? 0 : ( n[ i - 1 ] >> ( BLOCK_BIT - s ) ) );
+   }
+   un[ 0 ] = n[ 0 ] << s;
+
+   const ucarry_t base = ( ( ucarry_t ) 1 ) << BLOCK_BIT;
+
+   for ( int j = ln - ld; j >= 0; j-- ){
+
+      const ucarry_t num  = ( ( ( ucarry_t ) un[ j + ld ] ) << BLOCK_BIT ) + un[ j + ld - 1 ];
+            ucarry_t qhat = num / vn[ ld - 1 ];
+            ucarry_t rhat = num - qhat * vn[ ld - 1 ];
+      while ( ( qhat >= base ) || ( qhat * vn[ ld - 2 ] > ( ( rhat << BLOCK_BIT ) + un[ j + ld - 2 ] ) ) ){
+         qhat--;
+         rhat += vn[ ld - 1 ];
+         if ( rhat >= base ){ break; }
+      }
+
+      // un[ j : j + ld ] -= qhat * vn
+      long long t;
+      ucarry_t  k = 0;
+      for ( int i = 0; i < ld; i++ ){
+         const ucarry_t p = qhat * vn[ i ];
+         t = ( ( long long ) un[ i + j ] ) - ( ( long long ) k ) - ( ( long long )( p & __11111111__ ) );
+         un[ i + j ] = ( ubase_t ) t;
+         k = ( p >> BLOCK_BIT ) - ( t >> BLOCK_BIT );
+      }
+      t = ( ( long long ) un[ j + ld ] ) - ( ( long long ) k );
+      un[ j + ld ] = ( ubase_t ) t;
+
+      if ( t < 0 ){ // qhat was one too large: add vn back
+         ucarry_t z = 0;
+         for ( int i = 0; i < ld; i++ ){
+            z = z + un[ i + j ] + vn[ i ];
+            un[ i + j ] = z & __11111111__;
+            z = z >> BLOCK_BIT;
+         }
+         un[ j + ld ] += z;
+      }
+   }
+
+   // Denormalize the remainder
+   rem.resize( ld );
+   for ( int i = 0; i < ld; i++ ){
+      rem[ i ] = ( un[ i ] >> s ) | ( ( s == 0 ) ? 0 : ( un[ i + 1 ] << ( BLOCK_BIT - s ) ) );
+   }
+   while ( ( rem.size() > 0 ) && ( rem.back() == 0 ) ){ rem.pop_back(); }
+
+}
+
+void jans::big_int::__long_mult__( ubase_t * r, const ubase_t * a, const int la, const ubase_t * b, const int lb ){
+
+   // r[ 0 : la + lb ] = a * b ( Karatsuba ); r need not be cleared on entry
+
+   if ( la < lb ){ __long_mult__( r, b, lb, a, la ); return; }
+
+   for ( int i = 0; i < la + lb; i++ ){ r[ i ] = 0; }
+   if ( lb == 0 ){ return; }
+
+   if ( lb < KARATSUBA_CUTOFF ){ // Schoolbook
+      for ( int ib = 0; ib < lb; ib++ ){
+         const ucarry_t f = b[ ib ];
+         ucarry_t z = 0;
+         for ( int ia = 0; ia < la; ia++ ){
+            z = z + r[ ia + ib ] + ( f * a[ ia ] );
+            r[ ia + ib ] = z & __11111111__;
+            z = z >> BLOCK_BIT;
+         }
+         r[ la + ib ] = z;
+      }
+      return;
+   }
+
+   if ( 2 * lb <= la ){ // Unbalanced: multiply b with chunks of a of length lb
+      std::vector<ubase_t> temp( 2 * lb );
+      for ( int start = 0; start < la; start += lb ){
+         const int len = ( ( start + lb <= la ) ? lb : ( la - start ) );
+         __long_mult__( temp.data(), a + start, len, b, lb );
+         ucarry_t z = 0;
+         for ( int i = 0; i < len + lb; i++ ){
+            z = z + r[ start + i ] + temp[ i ];
+            r[ start + i ] = z & __11111111__;
+            z = z >> BLOCK_BIT;
+         }
+         for ( int i = start + len + lb; ( z != 0 ) && ( i < la + lb ); i++ ){
+            z = z + r[ i ];
+            r[ i ] = z & __11111111__;
+            z = z >> BLOCK_BIT;
+         }
+      }
+      return;
+   }
+
+   // a = a0 + a1 X^m, b = b0 + b1 X^m, with lb > m
+   const int m   = la / 2;
+   const int la1 = la - m;
+   const int lb1 = lb - m;
+
+   const int lsb = ( ( lb1 > m ) ? lb1 : m );
+   std::vector<ubase_t> sa( la1 + 1, 0 ); // a0 + a1 ( la1 >= m )
+   std::vector<ubase_t> sb( lsb + 1, 0 ); // b0 + b1
+   {
+      ucarry_t z = 0;
+      for ( int i = 0; i < la1; i++ ){
+         z = z + ( ( i < m ) ? a[ i ] : 0 ) + a[ m + i ];
+         sa[ i ] = z & __11111111__;
+         z = z >> BLOCK_BIT;
+      }
+      sa[ la1 ] = z;
+      z = 0;
+      for ( int i = 0; i < lsb; i++ ){
+         z = z + ( ( i < m ) ? b[ i ] : 0 ) + ( ( i < lb1 ) ? b[ m + i ] : 0 );
+         sb[ i ] = z & __11111111__;
+         z = z >> BLOCK_BIT;
+      }
+      sb[ lsb ] = z;
+   }
+
+   std::vector<ubase_t> z1( la1 + lsb + 2 );
+   __long_mult__( r, a, m, b, m );                               // r[ 0 : 2m ]        = z0
+   __long_mult__( r + 2 * m, a + m, la1, b + m, lb1 );           // r[ 2m : la + lb ]  = z2
+   __long_mult__( z1.data(), sa.data(), la1 + 1, sb.data(), lsb + 1 ); // z1 = ( a0 + a1 ) * ( b0 + b1 )
+
+   // z1 -= z0 + z2 ( never negative )
+   long long t;
+   long long borrow = 0;
+   const int lz = la1 + lsb + 2;
+   for ( int i = 0; i < lz; i++ ){
+      const long long z0 = ( ( i < 2 * m ) ? r[ i ] : 0 );
+      const long long z2 = ( ( i < la1 + lb1 ) ? r[ 2 * m + i ] : 0 );
+      t = ( ( long long ) z1[ i ] ) - z0 - z2 - borrow;
+      borrow = 0;
+      while ( t < 0 ){ t += ( ( long long ) 1 ) << BLOCK_BIT; borrow++; }
+      z1[ i ] = ( ubase_t ) t;
+   }
+   assert( borrow == 0 );
+
+   // r += z1 X^m
+   ucarry_t z = 0;
+   for ( int i = 0; ( i < lz ) && ( m + i < la + lb ); i++ ){
+      z = z + r[ m + i ] + z1[ i ];
+      r[ m + i ] = z & __11111111__;
+      z = z >> BLOCK_BIT;
+   }
+   for ( int i = m + lz; ( z != 0 ) && ( i < la + lb ); i++ ){
+      z = z + r[ i ];
+      r[ i ] = z & __11111111__;
+      z = z >> BLOCK_BIT;
+   }
+
+}
+
@@ -0,0 +1,123 @@
+/*
+   JANS: just another number sieve
+   Copyright (C) 2018-2020 Sebastian Wouters
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+
+namespace jans {
+
+    /*
+        Bounded lock-free multi-producer multi-consumer queue (D. Vyukov):
+          - every cell carries a sequence number which tells producers and consumers whether it is their turn
+          - try_push fails when the queue is full and try_pop when it is empty; neither blocks
+          - capacity is rounded up to a power of two
+     */
+    template <typename T>
+    class bounded_queue
+    {
+        public:
+
+            explicit bounded_queue(const size_t capacity)
+            {
+                size_t size = 2U;
+                while (size < capacity){ size <<= 1U; }
+                mask = size - 1U;
+                cells = new cell[size];
+                for (size_t idx = 0U; idx < size; ++idx)
+                {
+                    cells[idx].sequence.store(idx, std::memory_order_relaxed);
+                }
+                head.store(0U, std::memory_order_relaxed);
+                tail.store(0U, std::memory_order_relaxed);
+            }
+
+            ~bounded_queue(){ delete [] cells; }
+
+            bounded_queue(const bounded_queue&) = delete;
+            bounded_queue& operator=(const bounded_queue&) = delete;
+
+            bool try_push(const T& item)
+            {
+                size_t pos = tail.load(std::memory_order_relaxed);
+                while (true)
+                {
+                    cell& c = cells[pos & mask];
+                    const size_t seq = c.sequence.load(std::memory_order_acquire);
+                    const ptrdiff_t diff = static_cast<ptrdiff_t>(seq) - static_cast<ptrdiff_t>(pos);
+                    if (diff == 0)
+                    {
+                        if (tail.compare_exchange_weak(pos, pos + 1U, std::memory_order_relaxed))
+                        {
+                            c.item = item;
+                            c.sequence.store(pos + 1U, std::memory_order_release);
+                            return true;
+                        }
+                    } else if (diff < 0) {
+                        return false; // full
+                    } else {
+                        pos = tail.load(std::memory_order_relaxed);
+                    }
+                }
+            }
+
+            bool try_pop(T& item)
+            {
+                size_t pos = head.load(std::memory_order_relaxed);
+                while (true)
+                {
+                    cell& c = cells[pos & mask];
+                    const size_t seq = c.sequence.load(std::memory_order_acquire);
+                    const ptrdiff_t diff = static_cast<ptrdiff_t>(seq) - static_cast<ptrdiff_t>(pos + 1U);
+                    if (diff == 0)
+                    {
+                        if (head.compare_exchange_weak(pos, pos + 1U, std::memory_order_relaxed))
+                        {
+                            item = c.item;
+                            c.sequence.store(pos + mask + 1U, std::memory_order_release);
+                            return true;
+                        }
+                    } else if (diff < 0) {
+                        return false; // empty
+                    } else {
+                        pos = head.load(std::memory_order_relaxed);
+                    }
+                }
+            }
+
+        private:
+
+            struct cell
+            {
+                std::atomic<size_t> sequence;
+                T item;
+            };
+
+            cell * cells;
+
+            size_t mask;
+
+            alignas(64) std::atomic<size_t> head; // next position to pop
+
+            alignas(64) std::atomic<size_t> tail; // next position to push
+    };
+}
+
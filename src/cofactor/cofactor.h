@@ -0,0 +1,46 @@
+/*
+   JANS: just another number sieve
+   Copyright (C) 2018-2020 Sebastian Wouters
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+namespace jans {
+
+    /*
+        Factoring of small integers n < 2^64, e.g. the cofactors which remain after trial division:
+          - is_prime    is a deterministic Miller-Rabin test
+          - pollard_rho is Brent's variant of Pollard rho in Montgomery arithmetic
+          - squfof      is Shanks' square forms factorization (n < 2^62)
+          - split       returns a non-trivial factor of a composite n
+          - factorize   returns all prime factors of n (with multiplicity, sorted)
+     */
+
+    namespace cofactor
+    {
+        bool     is_prime(const uint64_t n);
+        uint64_t pollard_rho(const uint64_t n, const uint64_t c, const uint64_t max_iter);
+        uint64_t squfof(const uint64_t n);
+        uint64_t split(const uint64_t n);
+        std::vector<uint64_t> factorize(const uint64_t n);
+    }
+}
+
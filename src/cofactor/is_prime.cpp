@@ -0,0 +1,69 @@
+/*
+   JANS: just another number sieve
+   Copyright (C) 2018-2020 Sebastian Wouters
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+#include "cofactor.h"
+#include "montgomery.h"
+
+/*
+    Deterministic Miller-Rabin for n < 2^64: the bases of Jim Sinclair suffice
+*/
+bool jans::cofactor::is_prime(const uint64_t n)
+{
+    static const uint64_t small_primes[] = { 2U, 3U, 5U, 7U, 11U, 13U, 17U, 19U, 23U, 29U, 31U, 37U };
+    for (const uint64_t p : small_primes)
+    {
+        if (n == p){ return true; }
+        if ((n % p) == 0U){ return false; }
+    }
+    if (n < 41U * 41U){ return (n > 1U); }
+
+    uint64_t u = n - 1U;
+    uint32_t r = 0U;
+    while ((u & 1U) == 0U)
+    {
+        u >>= 1U;
+        ++r;
+    } // n - 1 = 2^r * u
+
+    const montgomery mont(n);
+    const uint64_t one   = mont.one();
+    const uint64_t check = mont.sub(0U, one); // -1 mod n
+
+    static const uint64_t bases[] = { 2U, 325U, 9375U, 28178U, 450775U, 9780504U, 1795265022U };
+    for (const uint64_t base : bases)
+    {
+        const uint64_t a = base % n;
+        if (a == 0U){ continue; }
+
+        uint64_t work = mont.power(mont.to(a), u);
+        if ((work == one) || (work == check)){ continue; }
+
+        bool composite = true;
+        for (uint32_t i = 1U; (i < r) && (composite); ++i)
+        {
+            work = mont.mul(work, work);
+            if (work == check){ composite = false; }
+        }
+        if (composite){ return false; }
+    }
+
+    return true;
+}
+
@@ -0,0 +1,99 @@
+/*
+   JANS: just another number sieve
+   Copyright (C) 2018-2020 Sebastian Wouters
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+#pragma once
+
+#include <stdint.h>
+
+namespace jans {
+
+    namespace cofactor
+    {
+        /*
+            Montgomery arithmetic modulo an odd n < 2^64 with R = 2^64:
+              - numbers are kept in the form aR mod n
+              - mul(aR, bR) = abR mod n
+              - the reduction is written so that it does not overflow for n >= 2^63
+         */
+        class montgomery
+        {
+            public:
+
+                explicit montgomery(const uint64_t modulus) : n(modulus)
+                {
+                    // Newton iteration for n^{-1} mod 2^64: each step doubles the number of correct bits
+                    uint64_t inv = n; // correct for 3 bits as n * n = 1 mod 8
+                    for (int iter = 0; iter < 5; ++iter)
+                    {
+                        inv *= 2U - n * inv;
+                    }
+                    n_inv = inv;
+                    r1 = static_cast<uint64_t>((static_cast<unsigned __int128>(1U) << 64U) % n);
+                    r2 = static_cast<uint64_t>((static_cast<unsigned __int128>(r1) * r1) % n);
+                }
+
+                uint64_t modulus() const { return n; }
+
+                uint64_t one() const { return r1; }
+
+                uint64_t reduce(const unsigned __int128 t) const
+                {
+                    const uint64_t m  = static_cast<uint64_t>(t) * n_inv;
+                    const uint64_t hi = static_cast<uint64_t>(t >> 64U);
+                    const uint64_t mn = static_cast<uint64_t>((static_cast<unsigned __int128>(m) * n) >> 64U);
+                    return ((hi >= mn) ? (hi - mn) : (hi - mn + n)); // (t - mn) / R, as t and mn agree in the lower 64 bits
+                }
+
+                uint64_t to(const uint64_t a) const { return reduce(static_cast<unsigned __int128>(a % n) * r2); }
+
+                uint64_t from(const uint64_t a) const { return reduce(a); }
+
+                uint64_t mul(const uint64_t a, const uint64_t b) const { return reduce(static_cast<unsigned __int128>(a) * b); }
+
+                uint64_t add(const uint64_t a, const uint64_t b) const
+                {
+                    const uint64_t s = a + b;
+                    return (((s < a) || (s >= n)) ? (s - n) : s);
+                }
+
+                uint64_t sub(const uint64_t a, const uint64_t b) const { return ((a >= b) ? (a - b) : (a - b + n)); }
+
+                uint64_t power(uint64_t base, uint64_t expo) const
+                {
+                    uint64_t result = r1;
+                    while (expo)
+                    {
+                        if (expo & 1U){ result = mul(result, base); }
+                        base = mul(base, base);
+                        expo >>= 1U;
+                    }
+                    return result;
+                }
+
+            private:
+
+                uint64_t n;
+                uint64_t n_inv; // n * n_inv = 1 mod 2^64
+                uint64_t r1;    // R   mod n
+                uint64_t r2;    // R^2 mod n
+        };
+    }
+}
+
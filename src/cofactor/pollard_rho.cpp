@@ -0,0 +1,93 @@
+/*
+   JANS: just another number sieve
+   Copyright (C) 2018-2020 Sebastian Wouters
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+#include "cofactor.h"
+#include "montgomery.h"
+
+namespace {
+
+    uint64_t gcd(uint64_t a, uint64_t b)
+    {
+        while (b != 0U)
+        {
+            const uint64_t t = a % b;
+            a = b;
+            b = t;
+        }
+        return a;
+    }
+
+}
+
+/*
+    Returns a factor of the odd composite n (1 < factor < n) or 0 on failure; Brent's variant of Pollard rho with
+    f(y) = y^2 + c, whereby the products of the |x - y| are accumulated in batches before taking the gcd with n
+*/
+uint64_t jans::cofactor::pollard_rho(const uint64_t n, const uint64_t c, const uint64_t max_iter)
+{
+    const uint32_t batch = 128U;
+    const montgomery mont(n);
+    const uint64_t c_m = mont.to(c);
+
+    uint64_t y = mont.to(2U);
+    uint64_t x = y;
+    uint64_t q = mont.one();
+    uint64_t y_save = y;
+    uint64_t g = 1U;
+    uint64_t r = 1U;
+    uint64_t iter = 0U;
+
+    while ((g == 1U) && (iter < max_iter))
+    {
+        x = y;
+        for (uint64_t i = 0U; i < r; ++i){ y = mont.add(mont.mul(y, y), c_m); }
+        uint64_t k = 0U;
+        while ((k < r) && (g == 1U))
+        {
+            y_save = y;
+            const uint64_t steps = ((batch < r - k) ? batch : (r - k));
+            for (uint64_t i = 0U; i < steps; ++i)
+            {
+                y = mont.add(mont.mul(y, y), c_m);
+                q = mont.mul(q, mont.sub(x, y));
+            }
+            g = gcd(q, n);
+            k += steps;
+            iter += steps;
+        }
+        r <<= 1U;
+    }
+
+    if (g == n)
+    {
+        // The batch overshot: backtrack one step at a time from the last saved point
+        g = 1U;
+        y = y_save;
+        for (uint32_t i = 0U; (i < batch) && (g == 1U); ++i)
+        {
+            y = mont.add(mont.mul(y, y), c_m);
+            g = gcd(mont.sub(x, y), n);
+        }
+    }
+
+    if ((g == 1U) || (g == n)){ return 0U; }
+    return g;
+}
+
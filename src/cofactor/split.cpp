@@ -0,0 +1,83 @@
+/*
+   JANS: just another number sieve
+   Copyright (C) 2018-2020 Sebastian Wouters
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+#include <algorithm>
+
+#include "cofactor.h"
+
+/*
+    Returns a non-trivial factor of the composite n, or n itself if n is prime (or 1)
+*/
+uint64_t jans::cofactor::split(const uint64_t n)
+{
+    if (n < 4U){ return n; }
+    if ((n & 1U) == 0U){ return 2U; }
+
+    static const uint64_t small_primes[] = { 3U, 5U, 7U, 11U, 13U, 17U, 19U, 23U, 29U, 31U, 37U, 41U, 43U, 47U };
+    for (const uint64_t p : small_primes)
+    {
+        if ((n % p) == 0U){ return p; }
+    }
+
+    if (is_prime(n)){ return n; }
+
+    // Pollard-Brent is the workhorse; SQUFOF is the fallback when the rho sequence misbehaves
+    uint64_t factor = pollard_rho(n, 1U, 1U << 20U);
+    if (factor != 0U){ return factor; }
+
+    factor = squfof(n);
+    if (factor != 0U){ return factor; }
+
+    for (uint64_t c = 2U; c < 64U; ++c)
+    {
+        factor = pollard_rho(n, c, 1U << 24U);
+        if (factor != 0U){ return factor; }
+    }
+
+    return n;
+}
+
+/*
+    Returns the prime factors of n, with multiplicity and in increasing order; factorize(1) is empty
+*/
+std::vector<uint64_t> jans::cofactor::factorize(const uint64_t n)
+{
+    std::vector<uint64_t> factors;
+    std::vector<uint64_t> todo;
+    if (n > 1U){ todo.push_back(n); }
+
+    while (!todo.empty())
+    {
+        const uint64_t m = todo.back();
+        todo.pop_back();
+        const uint64_t d = split(m);
+        if ((d == m) || (d == 1U))
+        {
+            factors.push_back(m);
+        } else {
+            todo.push_back(d);
+            todo.push_back(m / d);
+        }
+    }
+
+    std::sort(factors.begin(), factors.end());
+    return factors;
+}
+
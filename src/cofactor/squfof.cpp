@@ -0,0 +1,121 @@
+/*
+   JANS: just another number sieve
+   Copyright (C) 2018-2020 Sebastian Wouters
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+#include <math.h>
+
+#include "cofactor.h"
+
+namespace {
+
+    uint64_t gcd(uint64_t a, uint64_t b)
+    {
+        while (b != 0U)
+        {
+            const uint64_t t = a % b;
+            a = b;
+            b = t;
+        }
+        return a;
+    }
+
+    uint64_t isqrt(const uint64_t n)
+    {
+        uint64_t r = static_cast<uint64_t>(sqrtl(static_cast<long double>(n)));
+        while (r * r > n){ --r; }
+        while ((r + 1U) * (r + 1U) <= n){ ++r; }
+        return r;
+    }
+
+    // Returns whether Q < 2^52 is a square; most non-squares are rejected by the squares mod 64
+    bool is_square(const uint64_t Q, uint64_t& r)
+    {
+        if (((0x202021202030213ULL >> (Q & 63U)) & 1U) == 0U){ return false; }
+        r = static_cast<uint64_t>(sqrt(static_cast<double>(Q)));
+        return (r * r == Q);
+    }
+
+}
+
+/*
+    Returns a factor of the odd composite n (1 < factor < n) or 0 on failure; Shanks' square forms factorization
+    with the racing multipliers of Gower & Wagstaff, restricted to k * n < 2^62
+*/
+uint64_t jans::cofactor::squfof(const uint64_t n)
+{
+    static const uint64_t multipliers[] = { 1U, 3U, 5U, 7U, 11U, 3U * 5U, 3U * 7U, 3U * 11U, 5U * 7U, 5U * 11U, 7U * 11U,
+                                            3U * 5U * 7U, 3U * 5U * 11U, 3U * 7U * 11U, 5U * 7U * 11U, 3U * 5U * 7U * 11U };
+
+    const uint64_t s = isqrt(n);
+    if (s * s == n){ return s; }
+
+    for (const uint64_t k : multipliers)
+    {
+        if (n >= (static_cast<uint64_t>(1U) << 62U) / k){ break; }
+
+        const uint64_t D  = k * n;
+        const uint64_t Po = isqrt(D);
+        uint64_t P     = Po;
+        uint64_t Pprev = Po;
+        uint64_t Qprev = 1U;
+        uint64_t Q     = D - Po * Po;
+        if (Q == 0U){ continue; }
+
+        // Forward cycle: find a square Q_i at even i
+        const uint64_t L = 2U * isqrt(2U * s);
+        const uint64_t B = 3U * L;
+        uint64_t r = 0U;
+        uint64_t i = 2U;
+        for (; i < B; ++i)
+        {
+            const uint64_t b = (Po + P) / Q;
+            P = b * Q - P;
+            const uint64_t q = Q;
+            Q = Qprev + b * (Pprev - P);
+            if (((i & 1U) == 0U) && (is_square(Q, r))){ break; }
+            Qprev = q;
+            Pprev = P;
+        }
+        if ((i >= B) || (r == 0U)){ continue; }
+
+        // Reverse cycle: from the square root form until P stabilizes
+        const uint64_t b = (Po - P) / r;
+        P = b * r + P;
+        Pprev = P;
+        Qprev = r;
+        Q = (D - Pprev * Pprev) / Qprev;
+        if (Q == 0U){ continue; }
+        uint64_t iter = 0U;
+        do {
+            const uint64_t c = (Po + P) / Q;
+            Pprev = P;
+            P = c * Q - P;
+            const uint64_t q = Q;
+            Q = Qprev + c * (Pprev - P);
+            Qprev = q;
+            ++iter;
+        } while ((P != Pprev) && (iter < B));
+
+        const uint64_t g = gcd(n, Qprev);
+        if ((g != 1U) && (g != n)){ return g; }
+    }
+
+    return 0U;
+}
+
@@ -26,6 +26,7 @@
 
 #include "big_int.h"
 #include "sieve.h"
+#include "cofactor/cofactor.h"
 
 void print_help(){
 
@@ -58,17 +59,86 @@ std::cout << "\n"
 "       -N, --number=integer\n"
 "              Number to factorize.\n"
 "\n"
+"       -K, --multiplier=integer\n"
+"              Sieve on kN instead of N, with k odd and squarefree\n"
+"              (default 0: Knuth-Schroeppel). A k sharing a factor\n"
+"              with N reports gcd( k, N ) as a factor of N.\n"
+"\n"
 "       -F, --factorbound=integer\n"
 "              Upper bound for factor base primes p <= F.\n"
 "\n"
 "       -M, --sievespace=integer\n"
 "              x in [-M, M] whereby M >= F.\n"
 "\n"
+"       -S, --blocksize=integer\n"
+"              Split [-M, M] in blocks of this size, which all threads\n"
+"              sieve for the same polynomial (default 0: each thread\n"
+"              sieves the full interval of its own polynomial).\n"
+"\n"
+"       -P, --pipeline=G,S,C\n"
+"              Run polynomial generation, sieving and checking as a\n"
+"              pipeline with G, S and C dedicated threads (default off).\n"
+"\n"
+"       -X, --batchsize=integer\n"
+"              Test the sieve survivors for smoothness in batches of this\n"
+"              size with product and remainder trees (default 0: trial\n"
+"              division of each survivor).\n"
+"\n"
+"       -R, --relations=file\n"
+"              Append the relations to this binary log while sieving.\n"
+"\n"
+"       -r, --resume\n"
+"              Load the relations in the log of -R, --relations and\n"
+"              continue sieving where the previous run stopped.\n"
+"\n"
+"       -C, --coordinator=port\n"
+"              Do not sieve, but hand out ranges of polynomials to the\n"
+"              workers which connect to this TCP port, and collect their\n"
+"              relations.\n"
+"\n"
+"       -W, --worker=host:port\n"
+"              Sieve the ranges of polynomials handed out by the\n"
+"              coordinator at host:port. The coordinator and its workers\n"
+"              should use the same -N, -K, -F and -M.\n"
+"\n"
+"       -V, --verify\n"
+"              Recompute Q(x) of every relation from its prime factors\n"
+"              before the linear algebra, and drop the bad relations.\n"
+"\n"
+"       -A, --autotune\n"
+"              Choose -F, -M and -T when they are not specified: from\n"
+"              the calibration file if it contains a similar N, else by\n"
+"              sieving a few polynomials for candidates around a table\n"
+"              value by number of digits.\n"
+"\n"
+"       -c, --calibration=file\n"
+"              Calibration file of -A, --autotune: read, and appended\n"
+"              with the result of the trial sieving.\n"
+"\n"
+"       -L, --linalg=solver\n"
+"              Nullspace solver: gaussian (default), lanczos or\n"
+"              wiedemann. Block Lanczos or block Wiedemann is required\n"
+"              for large factor bases. Block Wiedemann computes one\n"
+"              Krylov sequence per thread.\n"
+"\n"
+"       -O, --out-of-core=directory\n"
+"              Keep the dense matrix of -L gaussian in a memory-mapped\n"
+"              file in this directory instead of in memory, for factor\n"
+"              bases which do not fit in RAM.\n"
+"\n"
 "       -Z, --congruences=integer\n"
 "              Number of congruences to construct (default 11).\n"
 "\n"
 "       -T, --threshold=float\n"
 "              Threshold for attempting trial division (default 8.0).\n"
+"              Survivors with a cofactor of one or two primes up to 64 F\n"
+"              are kept as partial relations, which combine in the\n"
+"              matrix: a threshold near log( 64 F ) admits them.\n"
+"\n"
+"       -a, --adaptive\n"
+"              Adapt the threshold -T while sieving, from the number of\n"
+"              survivors and smooth numbers per deficit bin, and report\n"
+"              the chosen threshold and the histogram at the end.\n"
 "\n"
 "       -B, --bits=integer\n"
 "              Large integer bit precision. Should be a multiple of " << BASE_UNIT << " (default 1024).\n"
@@ -92,10 +162,25 @@ std::cout << "\n"
 
 int main( int argc, char ** argv ){
 
+   ubase_t multiplier  = 0;
    ubase_t factorbound = 0;
    ubase_t sievespace  = 0;
+   ubase_t blocksize   = 0;
+   int     pipeline[ 3 ] = { 0, 0, 0 };
+   ubase_t batchsize   = 0;
+   std::string logfile;
+   bool    resume      = false;
+   int     coordinator = 0;
+   bool    verify      = false;
+   std::string worker_host;
+   int     worker_port = 0;
    ubase_t congruences = 11;
-   double  threshold   = 8.0;
+   double  threshold   = -1.0; // Default 8.0
+   bool    autotune    = false;
+   bool    adaptive    = false;
+   int     linalg      = LINALG_GAUSSIAN;
+   std::string scratch;
+   std::string calibration;
    ubase_t bits        = 1024;
 
    std::string temp_str;
@@ -104,10 +189,24 @@ int main( int argc, char ** argv ){
    struct option long_options[] =
    {
       {"number",      required_argument, 0, 'N'},
+      {"multiplier",  required_argument, 0, 'K'},
       {"factorbound", required_argument, 0, 'F'},
       {"sievespace",  required_argument, 0, 'M'},
+      {"blocksize",   required_argument, 0, 'S'},
+      {"pipeline",    required_argument, 0, 'P'},
+      {"batchsize",   required_argument, 0, 'X'},
+      {"relations",   required_argument, 0, 'R'},
+      {"resume",      no_argument,       0, 'r'},
+      {"coordinator", required_argument, 0, 'C'},
+      {"worker",      required_argument, 0, 'W'},
+      {"verify",      no_argument,       0, 'V'},
+      {"autotune",    no_argument,       0, 'A'},
+      {"calibration", required_argument, 0, 'c'},
+      {"linalg",      required_argument, 0, 'L'},
+      {"out-of-core", required_argument, 0, 'O'},
       {"congruences", required_argument, 0, 'Z'},
       {"threshold",   required_argument, 0, 'T'},
+      {"adaptive",    no_argument,       0, 'a'},
       {"bits",        required_argument, 0, 'B'},
       {"version",     no_argument,       0, 'v'},
       {"help",        no_argument,       0, 'h'},
@@ -116,7 +215,7 @@ int main( int argc, char ** argv ){
 
    int option_index = 0;
    int c;
-   while (( c = getopt_long( argc, argv, "hvN:F:M:Z:T:B:", long_options, &option_index )) != -1 ){
+   while (( c = getopt_long( argc, argv, "hvrVAaN:K:F:M:S:P:X:R:C:W:c:L:O:Z:T:B:", long_options, &option_index )) != -1 ){
       switch( c ){
          case 'h':
          case '?':
@@ -130,6 +229,20 @@ int main( int argc, char ** argv ){
          case 'N':
             temp_str = optarg;
             break;
+         case 'K':
+            temp_int = atol( optarg );
+            if ( ( temp_int < 0 ) || ( ( ( temp_int % 2 ) == 0 ) && ( temp_int != 0 ) ) ){
+               std::cerr << "   Error: -K, --multiplier should be an odd positive integer (or 0)" << std::endl;
+               return 7;
+            }
+            for ( long long p = 3; p * p <= temp_int; p += 2 ){ // Square factors of k would only be sieve overhead
+               if ( temp_int % ( p * p ) == 0 ){
+                  std::cerr << "   Error: -K, --multiplier should be squarefree" << std::endl;
+                  return 7;
+               }
+            }
+            multiplier = temp_int;
+            break;
          case 'F':
             temp_int = atol( optarg );
             if ( temp_int < 1 ){
@@ -146,6 +259,77 @@ int main( int argc, char ** argv ){
             }
             sievespace = temp_int;
             break;
+         case 'S':
+            temp_int = atol( optarg );
+            if ( temp_int < 0 ){
+               std::cerr << "   Error: -S, --blocksize should be a positive integer (or 0)" << std::endl;
+               return 7;
+            }
+            blocksize = temp_int;
+            break;
+         case 'P':
+            if ( ( sscanf( optarg, "%d,%d,%d", &pipeline[ 0 ], &pipeline[ 1 ], &pipeline[ 2 ] ) != 3 )
+              || ( pipeline[ 0 ] < 1 ) || ( pipeline[ 1 ] < 1 ) || ( pipeline[ 2 ] < 1 ) ){
+               std::cerr << "   Error: -P, --pipeline should be three non-zero positive integers G,S,C" << std::endl;
+               return 7;
+            }
+            break;
+         case 'X':
+            temp_int = atol( optarg );
+            if ( temp_int < 0 ){
+               std::cerr << "   Error: -X, --batchsize should be a positive integer (or 0)" << std::endl;
+               return 7;
+            }
+            batchsize = temp_int;
+            break;
+         case 'R':
+            logfile = optarg;
+            break;
+         case 'r':
+            resume = true;
+            break;
+         case 'C':
+            temp_int = atol( optarg );
+            if ( ( temp_int < 1 ) || ( temp_int > 65535 ) ){
+               std::cerr << "   Error: -C, --coordinator should be a TCP port" << std::endl;
+               return 7;
+            }
+            coordinator = temp_int;
+            break;
+         case 'W':
+            worker_host = optarg;
+            temp_int = ( ( worker_host.rfind( ':' ) == std::string::npos ) ? 0 : atol( worker_host.substr( worker_host.rfind( ':' ) + 1 ).c_str() ) );
+            if ( ( temp_int < 1 ) || ( temp_int > 65535 ) || ( worker_host.rfind( ':' ) == 0 ) ){
+               std::cerr << "   Error: -W, --worker should be host:port" << std::endl;
+               return 7;
+            }
+            worker_port = temp_int;
+            worker_host = worker_host.substr( 0, worker_host.rfind( ':' ) );
+            break;
+         case 'V':
+            verify = true;
+            break;
+         case 'A':
+            autotune = true;
+            break;
+         case 'a':
+            adaptive = true;
+            break;
+         case 'c':
+            calibration = optarg;
+            break;
+         case 'L':
+            if ( std::string( optarg ) == "gaussian" ){ linalg = LINALG_GAUSSIAN; }
+            else if ( std::string( optarg ) == "lanczos" ){ linalg = LINALG_LANCZOS; }
+            else if ( std::string( optarg ) == "wiedemann" ){ linalg = LINALG_WIEDEMANN; }
+            else {
+               std::cerr << "   Error: -L, --linalg should be gaussian, lanczos or wiedemann" << std::endl;
+               return 7;
+            }
+            break;
+         case 'O':
+            scratch = optarg;
+            break;
          case 'Z':
             temp_int = atol( optarg );
             if ( temp_int < 1 ){
@@ -194,10 +378,29 @@ int main( int argc, char ** argv ){
       return 11;
    }
 
+   ucarry_t small = 0;
+   if ( jans::big_int::i2u( number, small ) ){ // Fast path: N fits in 64 bits
+      const ucarry_t factor = jans::cofactor::split( small );
+      if ( ( factor == small ) || ( factor == 1 ) ){
+         std::cerr << "   Error: -N, --number should not be a prime" << std::endl;
+         return 11;
+      }
+      std::cout << "Factored N = P x Q with" << std::endl;
+      std::cout << "      N = " << small << std::endl;
+      std::cout << "      P = " << factor << std::endl;
+      std::cout << "      Q = " << small / factor << std::endl;
+      return 0;
+   }
+
+   if ( autotune ){
+      jans::sieve::autotune( number, factorbound, sievespace, threshold, calibration );
+   }
+   if ( threshold < 0.0 ){ threshold = 8.0; }
+
    if ( factorbound == 0 ){
       const ucarry_t optbound = jans::sieve::optimal_factorbound( number );
       std::cerr << "   Error: -F, --factorbound should be specified" << std::endl;
-      std::cerr << "   A well-educated suggestion is -F " << optbound << std::endl;
+      std::cerr << "   A well-educated suggestion is -F " << optbound << " (or -A, --autotune)" << std::endl;
       return 11;
    }
 
@@ -211,19 +414,75 @@ int main( int argc, char ** argv ){
       return 11;
    }
 
+   if ( ( coordinator > 0 ) && ( worker_port > 0 ) ){
+      std::cerr << "   Error: -C, --coordinator and -W, --worker exclude each other" << std::endl;
+      return 11;
+   }
+
+   if ( ( resume ) && ( logfile.length() == 0 ) ){
+      std::cerr << "   Error: -r, --resume requires -R, --relations" << std::endl;
+      return 11;
+   }
+
+   if ( multiplier == 0 ){
+      multiplier = jans::sieve::optimal_multiplier( number, factorbound );
+   }
+
+   { // A multiplier sharing a prime with N is a factor of N already
+      jans::big_int quotient;
+      ubase_t common = multiplier;
+      ubase_t rem    = jans::big_int::div( quotient, number, multiplier );
+      while ( rem != 0 ){ const ubase_t temp = common % rem; common = rem; rem = temp; }
+      if ( common > 1 ){
+         jans::big_int::div( quotient, number, common );
+         std::cout << "Factored N = P x Q with" << std::endl;
+         std::cout << "      N = " << number.write( 10 ) << std::endl;
+         std::cout << "      P = " << common << std::endl;
+         std::cout << "      Q = " << quotient.write( 10 ) << std::endl;
+         return 0;
+      }
+   }
+
    std::cout << "Parsed command: " << std::endl;
    std::cout << "./jans -N " << number.write( 10 )
+                   << " -K " << multiplier
                    << " -F " << factorbound
                    << " -M " << sievespace
+                   << " -S " << blocksize
+                   << " -X " << batchsize
                    << " -Z " << congruences
                    << " -T " << threshold
-                   << " -B " << bits << std::endl;
+                   << " -B " << bits;
+   if ( pipeline[ 0 ] > 0 ){
+      std::cout << " -P " << pipeline[ 0 ] << "," << pipeline[ 1 ] << "," << pipeline[ 2 ];
+   }
+   if ( logfile.length() > 0 ){
+      std::cout << " -R " << logfile << ( ( resume ) ? " -r" : "" );
+   }
+   if ( coordinator > 0 ){ std::cout << " -C " << coordinator; }
+   if ( worker_port > 0 ){ std::cout << " -W " << worker_host << ":" << worker_port; }
+   if ( verify ){ std::cout << " -V"; }
+   if ( adaptive ){ std::cout << " -a"; }
+   if ( linalg == LINALG_LANCZOS ){ std::cout << " -L lanczos"; }
+   if ( linalg == LINALG_WIEDEMANN ){ std::cout << " -L wiedemann"; }
+   if ( scratch.length() > 0 ){ std::cout << " -O " << scratch; }
+   std::cout << std::endl;
 
    jans::big_int sol_p;
    jans::big_int sol_q;
 
-   jans::sieve mysieve( number, factorbound, sievespace, congruences );
-   mysieve.run( sol_p, sol_q, threshold );
+   jans::sieve mysieve( number, multiplier, factorbound, sievespace, congruences );
+   mysieve.set_blocksize( blocksize );
+   mysieve.set_pipeline( pipeline[ 0 ], pipeline[ 1 ], pipeline[ 2 ] );
+   mysieve.set_batchsize( batchsize );
+   mysieve.set_verify( verify );
+   mysieve.set_adaptive( adaptive );
+   mysieve.set_linalg( linalg );
+   if ( ( scratch.length() > 0 ) && ( mysieve.set_scratch( scratch ) == false ) ){ return 11; }
+   if ( worker_port > 0 ){ return ( ( mysieve.work( worker_host, worker_port, threshold ) ) ? 0 : 11 ); }
+   if ( ( logfile.length() > 0 ) && ( mysieve.set_logfile( logfile, resume ) == false ) ){ return 11; }
+   if ( ( coordinator > 0 ) && ( mysieve.set_coordinator( coordinator ) == false ) ){ return 11; }
+   if ( mysieve.run( sol_p, sol_q, threshold ) == false ){ return 13; }
 
    std::cout << "Factored N = P x Q with" << std::endl;
    std::cout << "      N = " << number.write( 10 ) << std::endl;
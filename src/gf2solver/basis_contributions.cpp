@@ -24,21 +24,27 @@
 #include "gf2solver.h"
 
 /*
-    Returns the basis_indices (0 <= basis_index < basis_size) which can contribute to the nullspace of space
+    Returns the basis_indices (0 <= basis_index < basis_size) which can contribute to the nullspace of space:
+    one counting pass over the nonzeros of space
 */
 std::vector<uint32_t> jans::gf2solver::basis_contributions(const std::vector<sparse_vector>& space, const uint32_t basis_size)
 {
+    std::vector<uint32_t> occurs(basis_size, 0U);
+    for (const sparse_vector& vec : space)
+    {
+        for (const uint32_t basis_idx : vec)
+        {
+            ++occurs[basis_idx];
+        }
+    }
+
     std::vector<uint32_t> contributions;
     contributions.reserve(basis_size);
-
     for (uint32_t basis_idx = 0U; basis_idx < basis_size; ++basis_idx)
     {
-        for (const sparse_vector& vec : space){
-            if (std::find(vec.begin(), vec.end(), basis_idx) != vec.end())
-            {
-                contributions.push_back(basis_idx);
-                break;
-            }
+        if (occurs[basis_idx] > 0U)
+        {
+            contributions.push_back(basis_idx);
         }
     }
 
@@ -0,0 +1,223 @@
+/*
+   JANS: just another number sieve
+   Copyright (C) 2018-2020 Sebastian Wouters
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+#include <stdio.h>
+#include <algorithm>
+
+#include "gf2solver.h"
+
+/*
+    Blocks of 64 vectors over GF(2): word i of a block is row i, bit k is column k.
+*/
+
+/*
+    c = a * b for 64 x 64 matrices (c may alias a or b)
+*/
+void jans::gf2solver::mul_64x64(const uint64_t * a, const uint64_t * b, uint64_t * c)
+{
+    uint64_t result[64];
+    for (uint32_t row = 0U; row < 64U; ++row)
+    {
+        uint64_t word = 0U;
+        uint64_t bits = a[row];
+        for (uint32_t col = 0U; bits != 0U; ++col, bits >>= 1U)
+        {
+            if (bits & 1U)
+            {
+                word ^= b[col];
+            }
+        }
+        result[row] = word;
+    }
+    std::copy(result, result + 64, c);
+}
+
+/*
+    c = x^T * y (64 x 64) for blocks x and y, with one table per byte of x[i]
+*/
+void jans::gf2solver::mul_transpose(const block& x, const block& y, uint64_t * c)
+{
+    std::vector<uint64_t> table(8U * 256U, 0U);
+
+    #pragma omp parallel
+    {
+        std::vector<uint64_t> temp(8U * 256U, 0U);
+
+        #pragma omp for schedule(static)
+        for (uint32_t idx = 0U; idx < x.size(); ++idx)
+        {
+            const uint64_t word = x[idx];
+            for (uint32_t byte = 0U; byte < 8U; ++byte)
+            {
+                temp[256U * byte + ((word >> (8U * byte)) & 255U)] ^= y[idx];
+            }
+        }
+
+        #pragma omp critical
+        {
+            for (uint32_t entry = 0U; entry < 8U * 256U; ++entry)
+            {
+                table[entry] ^= temp[entry];
+            }
+        }
+    }
+
+    for (uint32_t row = 0U; row < 64U; ++row)
+    {
+        const uint64_t * byte_table = table.data() + 256U * (row >> 3U);
+        uint64_t word = 0U;
+        for (uint32_t value = 0U; value < 256U; ++value)
+        {
+            if ((value >> (row & 7U)) & 1U)
+            {
+                word ^= byte_table[value];
+            }
+        }
+        c[row] = word;
+    }
+}
+
+/*
+    y ^= x * m for blocks x and y and a 64 x 64 matrix m
+*/
+void jans::gf2solver::mul_accumulate(const block& x, const uint64_t * m, block& y)
+{
+    uint64_t table[8][256];
+    for (uint32_t byte = 0U; byte < 8U; ++byte)
+    {
+        table[byte][0] = 0U;
+        for (uint32_t value = 1U; value < 256U; ++value)
+        {
+            const uint32_t low = value & (value - 1U); // value without its lowest bit
+            table[byte][value] = table[byte][low] ^ m[8U * byte + __builtin_ctz(value)];
+        }
+    }
+
+    #pragma omp parallel for schedule(static)
+    for (uint32_t idx = 0U; idx < x.size(); ++idx)
+    {
+        const uint64_t word = x[idx];
+        uint64_t result = 0U;
+        for (uint32_t byte = 0U; byte < 8U; ++byte)
+        {
+            result ^= table[byte][(word >> (8U * byte)) & 255U];
+        }
+        y[idx] ^= result;
+    }
+}
+
+namespace
+{
+    /*
+        Gauss-Jordan elimination of the active columns (words each) on the bits [first, last[:
+        returns whether each active column became a pivot
+    */
+    std::vector<uint8_t> eliminate(std::vector<uint64_t>& columns, const uint32_t words, const std::vector<uint8_t>& active, const uint64_t first, const uint64_t last)
+    {
+        const uint32_t num = active.size();
+        std::vector<uint8_t> pivot(num, 0U);
+        for (uint64_t bit = first; bit < last; ++bit)
+        {
+            const uint64_t word = bit >> 6U;
+            const uint64_t mask = static_cast<uint64_t>(1U) << (bit & 63U);
+            uint32_t col = 0U;
+            while ((col < num) && (!active[col] || pivot[col] || !(columns[words * col + word] & mask)))
+            {
+                ++col;
+            }
+            if (col == num)
+            {
+                continue;
+            }
+            pivot[col] = 1U;
+            const uint64_t * source = columns.data() + static_cast<uint64_t>(words) * col;
+            for (uint32_t other = 0U; other < num; ++other)
+            {
+                uint64_t * target = columns.data() + static_cast<uint64_t>(words) * other;
+                if ((other != col) && active[other] && (target[word] & mask))
+                {
+                    for (uint32_t idx = 0U; idx < words; ++idx)
+                    {
+                        target[idx] ^= source[idx];
+                    }
+                }
+            }
+        }
+        return pivot;
+    }
+}
+
+/*
+    The columns of x and v span (mostly) nullvectors of A = B^T B: combine them into independent nullvectors of B
+*/
+std::vector<std::vector<uint32_t>> jans::gf2solver::combine(const sparse_matrix& matrix, const block& x, const block& v)
+{
+    const uint32_t n = matrix.cols();
+    const uint32_t basis_size = matrix.rows();
+    block bx(basis_size);
+    block bv(basis_size);
+    matrix.multiply(x, bx);
+    matrix.multiply(v, bv);
+
+    // Column k: n bits of the vector, followed by basis_size bits of its image under B
+    const uint32_t words_vec = (n + 63U) >> 6U;
+    const uint32_t words = words_vec + ((basis_size + 63U) >> 6U);
+    std::vector<uint64_t> columns(128U * static_cast<uint64_t>(words), 0U);
+    for (uint32_t row = 0U; row < n; ++row)
+    {
+        for (uint32_t col = 0U; col < 64U; ++col)
+        {
+            const uint64_t bit = static_cast<uint64_t>(1U) << (row & 63U);
+            if ((x[row] >> col) & 1U) { columns[words * col + (row >> 6U)] |= bit; }
+            if ((v[row] >> col) & 1U) { columns[words * (col + 64U) + (row >> 6U)] |= bit; }
+        }
+    }
+    for (uint32_t row = 0U; row < basis_size; ++row)
+    {
+        for (uint32_t col = 0U; col < 64U; ++col)
+        {
+            const uint64_t bit = static_cast<uint64_t>(1U) << (row & 63U);
+            if ((bx[row] >> col) & 1U) { columns[words * col + words_vec + (row >> 6U)] |= bit; }
+            if ((bv[row] >> col) & 1U) { columns[words * (col + 64U) + words_vec + (row >> 6U)] |= bit; }
+        }
+    }
+
+    // Keep the independent vectors, then those of their combinations which B maps to zero
+    const std::vector<uint8_t> independent = eliminate(columns, words, std::vector<uint8_t>(128U, 1U), 0U, n);
+    const std::vector<uint8_t> nonzero_image = eliminate(columns, words, independent, 64U * words_vec, 64U * words_vec + basis_size);
+
+    std::vector<std::vector<uint32_t>> nullspace;
+    for (uint32_t col = 0U; col < 128U; ++col)
+    {
+        if (independent[col] && !nonzero_image[col])
+        {
+            std::vector<uint32_t> nullvector;
+            for (uint32_t row = 0U; row < n; ++row)
+            {
+                if ((columns[words * col + (row >> 6U)] >> (row & 63U)) & 1U)
+                {
+                    nullvector.push_back(row);
+                }
+            }
+            nullspace.push_back(nullvector);
+        }
+    }
+    return nullspace;
+}
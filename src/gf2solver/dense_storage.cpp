@@ -0,0 +1,81 @@
+/*
+   JANS: just another number sieve
+   Copyright (C) 2018-2020 Sebastian Wouters
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+#include <stdlib.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <iostream>
+
+#include "dense_storage.h"
+
+jans::gf2solver::dense_storage::dense_storage(const uint64_t num_words, const std::string& scratch) :
+    words(nullptr), map_size(0U)
+{
+    if (!scratch.empty() && (num_words > 0U))
+    {
+        std::string name = scratch + "/jans_gf2solver_XXXXXX";
+        const int fd = mkstemp(&name[0]);
+        if (fd >= 0)
+        {
+            unlink(name.c_str()); // The file disappears with the map, also when the process dies
+            const uint64_t size = num_words * sizeof(uint64_t);
+            if (ftruncate(fd, size) == 0) // Holes read as zero
+            {
+                void * map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                if (map != MAP_FAILED)
+                {
+                    madvise(map, size, MADV_SEQUENTIAL);
+                    words    = static_cast<uint64_t *>(map);
+                    map_size = size;
+                }
+            }
+            close(fd);
+        }
+        if (words == nullptr)
+        {
+            std::cerr << "jans::gf2solver::dense_storage: Cannot map " << num_words * sizeof(uint64_t) << " bytes in " << scratch << ", using memory instead." << std::endl;
+        }
+    }
+    if (words == nullptr)
+    {
+        heap.assign(num_words, 0U);
+        words = heap.data();
+    }
+}
+
+jans::gf2solver::dense_storage::~dense_storage()
+{
+    if (map_size > 0U) { munmap(words, map_size); }
+}
+
+void jans::gf2solver::dense_storage::release(const uint64_t first, const uint64_t last)
+{
+    if (map_size == 0U) { return; }
+
+    // Only whole pages in [first, last[ can be punched out of the file
+    const uint64_t page  = sysconf(_SC_PAGESIZE);
+    const uint64_t begin = ((first * sizeof(uint64_t) + page - 1U) / page) * page;
+    const uint64_t end   = ((last  * sizeof(uint64_t)) / page) * page;
+    if (begin < end)
+    {
+        madvise(reinterpret_cast<char *>(words) + begin, end - begin, MADV_REMOVE);
+    }
+}
@@ -0,0 +1,64 @@
+/*
+   JANS: just another number sieve
+   Copyright (C) 2018-2020 Sebastian Wouters
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace jans {
+
+    namespace gf2solver
+    {
+        /*
+            Zero-initialized array of 64-bit words for the dense solvers. With an empty scratch directory, the words
+            live on the heap. Otherwise, they live in a shared memory map of an unlinked temporary file in scratch,
+            so that the kernel writes cold pages back to disk instead of running out of memory: the elimination
+            streams over the rows in order, and the rows which are no longer needed are released.
+         */
+        class dense_storage
+        {
+            public:
+
+                dense_storage(const uint64_t num_words, const std::string& scratch);
+
+                ~dense_storage();
+
+                dense_storage(const dense_storage&) = delete;
+
+                dense_storage& operator=(const dense_storage&) = delete;
+
+                uint64_t * data() { return words; }
+
+                bool mapped() const { return (map_size > 0U); }
+
+                // Words [first, last[ are not read again: drop them from memory and disk
+                void release(const uint64_t first, const uint64_t last);
+
+            private:
+
+                uint64_t * words;
+
+                uint64_t map_size; // Bytes in the memory map, or 0 on the heap
+
+                std::vector<uint64_t> heap;
+        };
+    }
+}
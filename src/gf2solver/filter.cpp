@@ -0,0 +1,290 @@
+/*
+   JANS: just another number sieve
+   Copyright (C) 2018-2020 Sebastian Wouters
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+#include <stdio.h>
+#include <iostream>
+#include <algorithm>
+#include <numeric>
+
+#include "gf2solver.h"
+
+#define MERGE_MAX_WEIGHT 40 // Weight-2 merges which would create heavier sparse_vectors are skipped
+
+namespace
+{
+    /*
+        The sparse_vectors of a filtered_space which are still active, with per basis_index the number
+        of active sparse_vectors which contain it
+    */
+    class filter_state
+    {
+        public:
+
+            filter_state(const std::vector<jans::sparse_vector>& space, const uint32_t basis_size) :
+                rows(space), composition(space.size()), removed(space.size(), 0U), weight(basis_size, 0U), sum_idx(basis_size, 0U)
+            {
+                for (uint32_t row = 0U; row < space.size(); ++row)
+                {
+                    composition[row].push_back(row);
+                }
+                count();
+            }
+
+            std::vector<jans::sparse_vector> rows;
+
+            std::vector<std::vector<uint32_t>> composition;
+
+            std::vector<uint8_t> removed;
+
+            std::vector<uint32_t> weight;
+
+            std::vector<uint32_t> sum_idx; // Sum of the active rows containing basis_idx: the row if weight == 1
+
+            uint32_t num_rows = 0U;
+
+            uint32_t num_cols = 0U;
+
+            int64_t excess() const { return static_cast<int64_t>(num_rows) - static_cast<int64_t>(num_cols); }
+
+            void count()
+            {
+                std::fill(weight.begin(), weight.end(), 0U);
+                std::fill(sum_idx.begin(), sum_idx.end(), 0U);
+                num_rows = 0U;
+                for (uint32_t row = 0U; row < rows.size(); ++row)
+                {
+                    if (removed[row]) { continue; }
+                    ++num_rows;
+                    for (const uint32_t basis_idx : rows[row])
+                    {
+                        ++weight[basis_idx];
+                        sum_idx[basis_idx] += row;
+                    }
+                }
+                num_cols = std::count_if(weight.begin(), weight.end(), [](const uint32_t w){ return w > 0U; });
+            }
+
+            void remove(const uint32_t row)
+            {
+                removed[row] = 1U;
+                --num_rows;
+                for (const uint32_t basis_idx : rows[row])
+                {
+                    --weight[basis_idx];
+                    sum_idx[basis_idx] -= row;
+                    if (weight[basis_idx] == 0U) { --num_cols; }
+                }
+            }
+
+            /*
+                Iterative singleton removal: returns the number of removed rows
+            */
+            uint32_t singletons()
+            {
+                std::vector<uint32_t> stack;
+                for (uint32_t basis_idx = 0U; basis_idx < weight.size(); ++basis_idx)
+                {
+                    if (weight[basis_idx] == 1U) { stack.push_back(basis_idx); }
+                }
+                uint32_t num_removed = 0U;
+                while (!stack.empty())
+                {
+                    const uint32_t basis_idx = stack.back();
+                    stack.pop_back();
+                    if (weight[basis_idx] != 1U) { continue; }
+                    const uint32_t row = sum_idx[basis_idx];
+                    remove(row);
+                    ++num_removed;
+                    for (const uint32_t other : rows[row])
+                    {
+                        if (weight[other] == 1U) { stack.push_back(other); }
+                    }
+                }
+                return num_removed;
+            }
+
+            /*
+                The two active rows of every basis_idx with weight 2 ( first == second == rows.size() otherwise )
+            */
+            void pairs(std::vector<uint32_t>& first, std::vector<uint32_t>& second) const
+            {
+                first.assign(weight.size(), rows.size());
+                second.assign(weight.size(), rows.size());
+                for (uint32_t row = 0U; row < rows.size(); ++row)
+                {
+                    if (removed[row]) { continue; }
+                    for (const uint32_t basis_idx : rows[row])
+                    {
+                        if (weight[basis_idx] != 2U) { continue; }
+                        if (first[basis_idx] == rows.size()) { first[basis_idx] = row; }
+                        else { second[basis_idx] = row; }
+                    }
+                }
+            }
+    };
+
+    uint32_t find_root(std::vector<uint32_t>& parent, uint32_t row)
+    {
+        while (parent[row] != row)
+        {
+            parent[row] = parent[parent[row]];
+            row = parent[row];
+        }
+        return row;
+    }
+}
+
+/*
+    Filtering before the nullspace solver, on column ( basis_index ) occurrence counts, linear in the nonzeros per pass:
+      - singletons: a basis_index in exactly one sparse_vector cannot be cancelled, so that sparse_vector is removed,
+        repeated until none are left
+      - cliques: while the excess ( sparse_vectors minus basis_indices ) exceeds target_excess, the largest cliques
+        ( sparse_vectors connected by basis_indices of weight 2, which singleton removal deletes together ) are removed
+      - merges: a basis_index of weight 2 is eliminated by replacing one of its sparse_vectors by the XOR of both
+    The result holds the remaining sparse_vectors and, per sparse_vector, the indices in space which it is the XOR of.
+*/
+jans::gf2solver::filtered_space jans::gf2solver::filter(const std::vector<sparse_vector>& space, const uint32_t basis_size, const uint32_t target_excess)
+{
+    filter_state state(space, basis_size);
+    const uint32_t num_singletons = state.singletons();
+
+    uint32_t num_cliques = 0U;
+    std::vector<uint32_t> first;
+    std::vector<uint32_t> second;
+    while (state.excess() > static_cast<int64_t>(target_excess))
+    {
+        std::vector<uint32_t> parent(state.rows.size());
+        std::iota(parent.begin(), parent.end(), 0U);
+        state.pairs(first, second);
+        for (uint32_t basis_idx = 0U; basis_idx < basis_size; ++basis_idx)
+        {
+            if (second[basis_idx] < state.rows.size())
+            {
+                parent[find_root(parent, first[basis_idx])] = find_root(parent, second[basis_idx]);
+            }
+        }
+        std::vector<uint32_t> size(state.rows.size(), 0U);
+        for (uint32_t row = 0U; row < state.rows.size(); ++row)
+        {
+            if (!state.removed[row]) { ++size[find_root(parent, row)]; }
+        }
+        std::vector<uint32_t> roots;
+        for (uint32_t row = 0U; row < state.rows.size(); ++row)
+        {
+            if (size[row] > 0U) { roots.push_back(row); }
+        }
+        std::stable_sort(roots.begin(), roots.end(), [&size](const uint32_t a, const uint32_t b){ return size[a] > size[b]; });
+
+        // A clique of k sparse_vectors takes at least k - 1 basis_indices with it, so removing it lowers the excess by at most one,
+        // and the singleton removal that follows never lowers it: removing half of the surplus per pass stays above target_excess
+        const uint32_t num_remove = std::min(static_cast<uint32_t>(roots.size()), std::max(1U, static_cast<uint32_t>(state.excess() - target_excess) / 2U));
+        if (num_remove == 0U) { break; }
+        std::vector<uint8_t> doomed(state.rows.size(), 0U);
+        for (uint32_t idx = 0U; idx < num_remove; ++idx)
+        {
+            doomed[roots[idx]] = 1U;
+        }
+        for (uint32_t row = 0U; row < state.rows.size(); ++row)
+        {
+            if ((!state.removed[row]) && doomed[find_root(parent, row)])
+            {
+                state.remove(row);
+            }
+        }
+        num_cliques += num_remove;
+        state.singletons();
+    }
+
+    uint32_t num_merges = 0U;
+    while (true)
+    {
+        state.pairs(first, second);
+        std::vector<uint8_t> touched(state.rows.size(), 0U);
+        uint32_t pass_merges = 0U;
+        for (uint32_t basis_idx = 0U; basis_idx < basis_size; ++basis_idx)
+        {
+            const uint32_t row1 = first[basis_idx];
+            const uint32_t row2 = second[basis_idx];
+            if ((row2 >= state.rows.size()) || touched[row1] || touched[row2]) { continue; }
+            sparse_vector merged;
+            std::set_symmetric_difference(state.rows[row1].begin(), state.rows[row1].end(),
+                                          state.rows[row2].begin(), state.rows[row2].end(), std::back_inserter(merged));
+            if (merged.size() > MERGE_MAX_WEIGHT) { continue; }
+            state.rows[row2].swap(merged);
+            state.composition[row2].insert(state.composition[row2].end(), state.composition[row1].begin(), state.composition[row1].end());
+            state.removed[row1] = 1U;
+            touched[row1] = 1U;
+            touched[row2] = 1U;
+            ++pass_merges;
+        }
+        if (pass_merges == 0U) { break; }
+        num_merges += pass_merges;
+        state.count();
+        state.singletons();
+    }
+
+    filtered_space result;
+    for (uint32_t row = 0U; row < state.rows.size(); ++row)
+    {
+        if (!state.removed[row])
+        {
+            result.space.push_back(std::move(state.rows[row]));
+            std::sort(state.composition[row].begin(), state.composition[row].end());
+            result.composition.push_back(std::move(state.composition[row]));
+        }
+    }
+
+    uint64_t nonzeros = 0U;
+    for (const sparse_vector& vec : result.space) { nonzeros += vec.size(); }
+    std::cout << "jans::gf2solver::filter: " << space.size() << " space vectors reduced to " << result.space.size()
+              << " (" << num_singletons << " singletons, " << num_cliques << " cliques, " << num_merges << " merges), "
+              << state.num_cols << " basis indices, excess " << state.excess() << ", " << nonzeros << " nonzeros." << std::endl;
+
+    return result;
+}
+
+/*
+    Maps a nullvector of a filtered_space back to the indices of the original space
+*/
+std::vector<uint32_t> jans::gf2solver::unfilter(const std::vector<uint32_t>& nullvector, const filtered_space& filtered)
+{
+    std::vector<uint32_t> original;
+    for (const uint32_t idx : nullvector)
+    {
+        const std::vector<uint32_t>& part = filtered.composition[idx];
+        original.insert(original.end(), part.begin(), part.end()); // The compositions are disjoint
+    }
+    std::sort(original.begin(), original.end());
+    return original;
+}
+
+/*
+    Maps std::vector<nullvector> of a filtered_space back to the indices of the original space
+*/
+std::vector<std::vector<uint32_t>> jans::gf2solver::unfilter(const std::vector<std::vector<uint32_t>>& nullspace, const filtered_space& filtered)
+{
+    std::vector<std::vector<uint32_t>> result;
+    result.reserve(nullspace.size());
+    for (const std::vector<uint32_t>& nullvector : nullspace)
+    {
+        result.push_back(unfilter(nullvector, filtered));
+    }
+    return result;
+}
@@ -17,16 +17,44 @@
    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 */
 
+
 #include <stdio.h>
 #include <iostream>
 #include <algorithm>
 
 #include "gf2solver.h"
+#include "dense_storage.h"
+
+#define M4RI_BITS  8   // Pivots per table of the Method of Four Russians
+#define PANEL_BITS 64  // Pivots per panel: one word of basis bits
+#define ROW_TILE   256 // Rows per task of the trailing update
+#define COL_TILE   64  // Words per pass over a row tile, so that the tables and rows stay in cache
 
 /*
     Returns std::vector<nullvector>, with nullvector = { index : XOR_index( space[index] ) == null_vector }
 */
-std::vector<std::vector<uint32_t>> jans::gf2solver::gaussian(const std::vector<sparse_vector>& space, const uint32_t basis_size)
+std::vector<std::vector<uint32_t>> jans::gf2solver::gaussian(const std::vector<sparse_vector>& space, const uint32_t basis_size, const std::string& scratch)
+{
+    std::vector<std::vector<uint32_t>> nullspace;
+    gaussian(space, basis_size, [&nullspace](const std::vector<uint32_t>& nullvector){ nullspace.push_back(nullvector); return false; }, scratch);
+    return nullspace;
+}
+
+/*
+    Hands every nullvector = { index : XOR_index( space[index] ) == null_vector } to sink, until sink returns true
+
+    Every sparse_vector becomes a row of 64-bit words: d_bas bits for the contributing basis indices, followed by
+    d_vec bits of identity which record the combination of sparse_vectors. Tiled forward elimination with the Method
+    of Four Russians, in one persistent thread team: per panel of PANEL_BITS basis bits, one thread finds the pivot rows
+    and reduces them among each other, the 2^M4RI_BITS combinations of every M4RI_BITS pivots are tabulated in parallel,
+    and the remaining rows are cleared on the panel by tasks, with one table lookup and XOR per M4RI_BITS pivots.
+
+    With a scratch directory, the matrix is a memory map of a file in scratch (out-of-core): every panel streams once
+    over the rows from start on, and the pivot rows of a panel are released from memory and disk once it is done.
+
+    The nullvectors stay packed in the identity bits of the rows from start on, and are only unpacked one at a time.
+*/
+void jans::gf2solver::gaussian(const std::vector<sparse_vector>& space, const uint32_t basis_size, const nullvector_sink& sink, const std::string& scratch)
 {
     const std::vector<uint32_t> contributions = basis_contributions(space, basis_size);
 
@@ -34,94 +62,182 @@ std::vector<std::vector<uint32_t>> jans::gf2solver::gaussian(const std::vector<s
     const uint32_t d_bas = contributions.size();
     const uint32_t d_row = d_bas + d_vec;
 
-    const uint32_t N_row = (d_row >> 3U) + (((d_row & 7U) > 0U) ? 1U : 0U);
-    const uint64_t X_row = static_cast<uint64_t>(N_row);
-
-    uint8_t * matrix = new uint8_t[X_row * d_vec];
+    const uint64_t words = (d_row + 63U) >> 6U;
+    dense_storage storage(words * d_vec, scratch);
+    uint64_t * const matrix = storage.data();
     /*
-     * matrix = [  d_bas x d_vec  ]
-     *          [  -------------  ]
-     *          [  d_vec x d_vec  ]
+     * matrix = [  d_vec x d_bas  |  d_vec x d_vec  ]
      */
 
+    // Column remap table: basis_index -> bit, then a single pass over the nonzeros
+    std::vector<uint32_t> position(basis_size, basis_size);
+    for (uint32_t bas = 0U; bas < d_bas; ++bas)
+    {
+        position[contributions[bas]] = bas;
+    }
+    #pragma omp parallel for schedule(static)
     for (uint32_t vec = 0U; vec < d_vec; ++vec)
     {
-        for (uint32_t row = 0U; row < N_row; ++row)
+        uint64_t * row = matrix + words * vec;
+        for (const uint32_t basis_idx : space[vec])
         {
-            matrix[row + X_row * vec] = 0U;
+            const uint32_t bit = position[basis_idx];
+            row[bit >> 6U] ^= static_cast<uint64_t>(1U) << (bit & 63U);
         }
-        uint32_t row = 0U;
-        const sparse_vector& space_vec = space[vec];
-        for (const uint32_t basis_idx : contributions)
-        {
-            if (std::find(space_vec.begin(), space_vec.end(), basis_idx) != space_vec.end())
-            {
-                matrix[(row >> 3U) + X_row * vec] |= static_cast<uint8_t>(1U) << (row & 7U);
-            }
-            ++row;
-        }
-        matrix[((d_bas + vec) >> 3U) + X_row * vec] |= static_cast<uint8_t>(1U) << ((d_bas + vec) & 7U);
+        row[(d_bas + vec) >> 6U] |= static_cast<uint64_t>(1U) << ((d_bas + vec) & 63U);
     }
 
-    uint32_t start = 0;
-    for (uint32_t bas = 0U; bas < d_bas; ++bas)
+    auto get = [matrix, words](const uint32_t vec, const uint32_t bit){ return (matrix[words * vec + (bit >> 6U)] >> (bit & 63U)) & 1U; };
+
+    std::vector<uint64_t> table(static_cast<uint64_t>(PANEL_BITS / M4RI_BITS) * (1U << M4RI_BITS) * words);
+    uint32_t pivot_bits[PANEL_BITS];
+    uint32_t num_pivots = 0U;
+    uint32_t start = 0U;
+
+    #pragma omp parallel
     {
-        bool found = false;
-        uint32_t iter = start;
-        const uint32_t ix = bas >> 3U;
-        const uint8_t  iy = bas  & 7U;
-        while ((!found) && (iter < d_vec)){
-            if ((matrix[ix + X_row * iter] >> iy) & static_cast<uint8_t>(1U))
+        for (uint32_t panel = 0U; (panel < d_bas) && (start < d_vec); panel += PANEL_BITS)
+        {
+            const uint64_t first_word = panel >> 6U; // Rows from start on are zero before panel
+            const uint64_t width = words - first_word;
+
+            // Panel factorization: up to PANEL_BITS pivot rows, reduced among each other on their pivot bits
+            #pragma omp single
             {
-                found = true;
-            } else {
-                ++iter;
+                num_pivots = 0U;
+                const uint32_t panel_end = std::min(panel + PANEL_BITS, d_bas);
+                for (uint32_t bas = panel; bas < panel_end; ++bas)
+                {
+                    const uint32_t pivot = start + num_pivots;
+                    uint32_t iter = pivot;
+                    while (iter < d_vec)
+                    {
+                        // The panel word of the candidate, reduced by the pivots found so far in this panel
+                        uint64_t panel_word = matrix[words * iter + first_word];
+                        for (uint32_t idx = 0U; idx < num_pivots; ++idx)
+                        {
+                            if ((panel_word >> (pivot_bits[idx] & 63U)) & 1U)
+                            {
+                                panel_word ^= matrix[words * (start + idx) + first_word];
+                            }
+                        }
+                        if ((panel_word >> (bas & 63U)) & 1U) { break; }
+                        ++iter;
+                    }
+                    if (iter == d_vec) { continue; }
+                    uint64_t * candidate = matrix + words * iter;
+                    for (uint32_t idx = 0U; idx < num_pivots; ++idx)
+                    {
+                        if (get(iter, pivot_bits[idx]))
+                        {
+                            const uint64_t * source = matrix + words * (start + idx);
+                            for (uint64_t word = first_word; word < words; ++word) { candidate[word] ^= source[word]; }
+                        }
+                    }
+                    if (iter != pivot)
+                    {
+                        std::swap_ranges(matrix + words * iter + first_word, matrix + words * (iter + 1U), matrix + words * pivot + first_word);
+                    }
+                    const uint64_t * source = matrix + words * pivot;
+                    for (uint32_t idx = 0U; idx < num_pivots; ++idx)
+                    {
+                        if (get(start + idx, bas))
+                        {
+                            uint64_t * row = matrix + words * (start + idx);
+                            for (uint64_t word = first_word; word < words; ++word) { row[word] ^= source[word]; }
+                        }
+                    }
+                    pivot_bits[num_pivots++] = bas;
+                }
             }
-        }
-        if (found){
-            if (iter != start){
-                for (uint32_t row = ix; row < N_row; ++row)
+
+            // Per M4RI_BITS pivots, table[ mask ] = XOR of the pivot rows selected by mask
+            const uint32_t num_tables = (num_pivots + M4RI_BITS - 1U) / M4RI_BITS;
+            #pragma omp for schedule(static)
+            for (uint32_t tab = 0U; tab < num_tables; ++tab)
+            {
+                const uint32_t size = std::min(static_cast<uint32_t>(M4RI_BITS), num_pivots - M4RI_BITS * tab);
+                uint64_t * tab_data = table.data() + static_cast<uint64_t>(tab) * (1U << M4RI_BITS) * width;
+                std::fill(tab_data, tab_data + width, 0U);
+                for (uint32_t mask = 1U; mask < (1U << size); ++mask)
                 {
-                    // Everything above specific bit has been cleared: bit-wise swapping (also for preceding bits) is OK.
-                    uint8_t swap = matrix[row + X_row * iter];
-                    matrix[row + X_row * iter ] = matrix[row + X_row * start];
-                    matrix[row + X_row * start] = swap;
+                    const uint32_t low = mask & (mask - 1U);
+                    const uint64_t * pivot_row = matrix + words * (start + M4RI_BITS * tab + __builtin_ctz(mask)) + first_word;
+                    uint64_t * target = tab_data + width * mask;
+                    const uint64_t * base = tab_data + width * low;
+                    for (uint64_t word = 0U; word < width; ++word) { target[word] = base[word] ^ pivot_row[word]; }
                 }
             }
-            #pragma omp parallel for schedule(static)
-            for (uint32_t vec = iter + 1; vec < d_vec; ++vec){
-                if ((matrix[ix + X_row * vec] >> iy) & static_cast<uint8_t>(1U))
+
+            // Trailing update as tasks on tiles of ROW_TILE rows, COL_TILE words at a time: the pivot rows are the
+            // identity on the pivot bits, so every row needs the table entries selected by its own pivot bits
+            #pragma omp single
+            {
+                for (uint32_t tile = start + num_pivots; tile < d_vec; tile += ROW_TILE)
                 {
-                    for (uint32_t row = ix; row < N_row; ++row){
-                        // Everything above specific bit has been cleared: bit-wise XOR (also for preceding bits) is OK.
-                        matrix[row + X_row * vec] ^= matrix[row + X_row * start];
+                    #pragma omp task firstprivate(tile)
+                    {
+                        const uint32_t tile_end = std::min(tile + ROW_TILE, d_vec);
+                        uint8_t masks[ROW_TILE][PANEL_BITS / M4RI_BITS];
+                        for (uint32_t vec = tile; vec < tile_end; ++vec)
+                        {
+                            for (uint32_t tab = 0U; tab < num_tables; ++tab)
+                            {
+                                uint32_t mask = 0U;
+                                for (uint32_t idx = M4RI_BITS * tab; idx < std::min(M4RI_BITS * (tab + 1U), num_pivots); ++idx)
+                                {
+                                    mask |= static_cast<uint32_t>(get(vec, pivot_bits[idx])) << (idx - M4RI_BITS * tab);
+                                }
+                                masks[vec - tile][tab] = mask;
+                            }
+                        }
+                        for (uint64_t col = 0U; col < width; col += COL_TILE)
+                        {
+                            const uint64_t col_end = std::min(col + COL_TILE, width);
+                            for (uint32_t vec = tile; vec < tile_end; ++vec)
+                            {
+                                uint64_t * row = matrix + words * vec + first_word;
+                                for (uint32_t tab = 0U; tab < num_tables; ++tab)
+                                {
+                                    const uint32_t mask = masks[vec - tile][tab];
+                                    if (mask == 0U) { continue; }
+                                    const uint64_t * entry = table.data() + (static_cast<uint64_t>(tab) * (1U << M4RI_BITS) + mask) * width;
+                                    for (uint64_t word = col; word < col_end; ++word) { row[word] ^= entry[word]; }
+                                }
+                            }
+                        }
                     }
                 }
+            } // Implicit barrier: all tasks are done
+
+            #pragma omp single
+            {
+                storage.release(words * start, words * (start + num_pivots));
+                start += num_pivots;
             }
-            ++start;
         }
     }
 
-    // Now matrix [0:d_bas, start:d_vec] == 0
+    // Now matrix [start:d_vec, 0:d_bas] == 0
 
     std::cout << "jans::gf2solver::gaussian: Found " << d_vec - start << " vectors in the nullspace." << std::endl;
 
-    std::vector<std::vector<uint32_t>> nullspace;
+    std::vector<uint32_t> nullvector;
     for (uint32_t sol = start; sol < d_vec; ++sol)
     {
-        std::vector<uint32_t> nullvector;
-        for (uint32_t row = d_bas; row < d_row; ++row){
-            if ((matrix[(row >> 3U) + X_row * sol] >> (row & 7U)) & static_cast<uint8_t>(1U))
+        nullvector.clear();
+        const uint64_t * row = matrix + words * sol;
+        for (uint64_t word = d_bas >> 6U; word < words; ++word)
+        {
+            uint64_t bits = row[word];
+            if (word == (d_bas >> 6U)) { bits &= ~((static_cast<uint64_t>(1U) << (d_bas & 63U)) - 1U); }
+            while (bits != 0U)
             {
-                // item (of list) = row - d_bas
-                nullvector.push_back(row - d_bas);
+                // item (of list) = bit - d_bas
+                nullvector.push_back(64U * word + __builtin_ctzll(bits) - d_bas);
+                bits &= bits - 1U;
             }
         }
-        nullspace.push_back(nullvector);
+        if (sink(nullvector)) { return; }
     }
-
-    delete [] matrix;
-
-    return nullspace;
 }
-
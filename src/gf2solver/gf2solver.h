@@ -19,8 +19,13 @@
 
 #pragma once
 
+#include <stdint.h>
+#include <functional>
+#include <string>
 #include <vector>
 
+#include "sparse_matrix.h"
+
 namespace jans {
 
     /*
@@ -33,20 +38,40 @@ namespace jans {
     // A sparse_vector contains all basis_index for which full_vector[basis_index] == 1
     using sparse_vector = std::vector<uint32_t>;
 
+    // Receives the nullvectors one at a time, and returns true when no more nullvectors are needed
+    using nullvector_sink = std::function<bool(const std::vector<uint32_t>&)>;
+
+    /*
+        block = n x 64 matrix over GF(2): word i is row i, bit k is column k
+        B     = basis_size x space.size() matrix whose columns are the sparse_vectors of space
+     */
+
     namespace gf2solver
     {
-        std::vector<uint32_t>   space_contributions(const std::vector<sparse_vector>& space, const uint32_t basis_size);
-        std::vector<uint32_t>   basis_contributions(const std::vector<sparse_vector>& space, const uint32_t basis_size);
-        std::vector<std::vector<uint32_t>> gaussian(const std::vector<sparse_vector>& space, const uint32_t basis_size);
+        // space[i] is the XOR of the sparse_vectors of the original space with indices composition[i]
+        struct filtered_space
+        {
+            std::vector<sparse_vector> space;
+            std::vector<std::vector<uint32_t>> composition;
+        };
 
-        std::vector<uint8_t> random(const uint32_t size);
-        std::vector<uint8_t> zeroes(const uint32_t size);
-        uint8_t dotproduct(const std::vector<uint8_t>& first, const std::vector<uint8_t>& second);
-        bool update_x(std::vector<uint8_t>& x, const std::vector<uint8_t>& v, const std::vector<uint8_t>& Av, const std::vector<uint8_t>& b);
+        std::vector<uint32_t>   basis_contributions(const std::vector<sparse_vector>& space, const uint32_t basis_size);
+        std::vector<uint32_t>     remove_singletons(const std::vector<sparse_vector>& space, const uint32_t basis_size, uint32_t& num_active);
+        filtered_space                       filter(const std::vector<sparse_vector>& space, const uint32_t basis_size, const uint32_t target_excess);
+        std::vector<std::vector<uint32_t>> unfilter(const std::vector<std::vector<uint32_t>>& nullspace, const filtered_space& filtered);
+        std::vector<uint32_t>              unfilter(const std::vector<uint32_t>& nullvector, const filtered_space& filtered);
+        std::vector<std::vector<uint32_t>> gaussian(const std::vector<sparse_vector>& space, const uint32_t basis_size, const std::string& scratch = "");
+        void                               gaussian(const std::vector<sparse_vector>& space, const uint32_t basis_size, const nullvector_sink& sink, const std::string& scratch = "");
+        std::vector<std::vector<uint32_t>> structured_gaussian(const std::vector<sparse_vector>& space, const uint32_t basis_size, const std::string& scratch = "");
+        void                               structured_gaussian(const std::vector<sparse_vector>& space, const uint32_t basis_size, const nullvector_sink& sink, const std::string& scratch = "");
+        std::vector<std::vector<uint32_t>>  lanczos(const std::vector<sparse_vector>& space, const uint32_t basis_size);
+        std::vector<std::vector<uint32_t>> wiedemann(const std::vector<sparse_vector>& space, const uint32_t basis_size);
 
-        std::vector<uint8_t>  first_half(const std::vector<sparse_vector>& space, const std::vector<uint8_t>& input, const uint32_t basis_size);
-        std::vector<uint8_t> second_half(const std::vector<sparse_vector>& space, const std::vector<uint8_t>& half,  const uint32_t basis_size);
-        std::vector<uint8_t>      matvec(const std::vector<sparse_vector>& space, const std::vector<uint8_t>& input, const uint32_t basis_size);
+        using block = std::vector<uint64_t>;
+        void           mul_64x64(const uint64_t * a, const uint64_t * b, uint64_t * c);            // c = a * b, 64 x 64
+        void       mul_transpose(const block& x, const block& y, uint64_t * c);                   // c = x^T * y, 64 x 64
+        void      mul_accumulate(const block& x, const uint64_t * m, block& y);                   // y ^= x * m
+        std::vector<std::vector<uint32_t>> combine(const sparse_matrix& matrix, const block& x, const block& v);
     }
 }
 
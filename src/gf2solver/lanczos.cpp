@@ -17,6 +17,7 @@
    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 */
 
+
 #include <stdio.h>
 #include <iostream>
 #include <algorithm>
@@ -24,219 +25,249 @@
 
 #include "gf2solver.h"
 
-/*
-    Return a random vector: TODO: should be bit-random in range [0, 2**NBIT[
-*/
-std::vector<uint8_t> jans::gf2solver::random(const uint32_t size)
-{
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> dis(0, 1);
-
-    std::vector<uint8_t> random_vector;
-    random_vector.reserve(size);
-    for (uint32_t iter = 0U; iter < size; ++iter)
-    {
-        random_vector.push_back(dis(gen));
-        //if (dis(gen))
-        //{
-        //    random_vector.push_back(iter);
-        //}
-    }
-    return random_vector;
-}
-
-/*
-    Return an empty vector
-*/
-std::vector<uint8_t> jans::gf2solver::zeroes(const uint32_t size)
-{
-    std::vector<uint8_t> result;
-    result.reserve(size);
-    for (uint32_t iter = 0U; iter < size; ++iter)
-    {
-        result.push_back(0U);
-    }
-    return result;
-}
+#define LANCZOS_ATTEMPTS 4
 
 /*
-    Dot product TODO: should become bitwise matrix
+    Montgomery's block Lanczos over GF(2), 64 vectors at a time: the iteration runs on the
+    symmetric A = B^T B, and the resulting candidates are combined into nullvectors of B.
 */
-uint8_t jans::gf2solver::dotproduct(const std::vector<uint8_t>& first, const std::vector<uint8_t>& second)
-{
-    assert(first.size() == second.size());
-    uint8_t result = 0U;
-    for (uint32_t idx = 0U; idx < first.size(); ++idx)
-    {
-        result ^= (first[idx] ^ second[idx]);
-    }
-}
 
-/*
-    Return half[basis_idx, bit] = sum_{space_idx} space[space_idx][basis_idx] * input[space_idx, bit]
-*/
-std::vector<uint8_t> jans::gf2solver::first_half(const std::vector<sparse_vector>& space, const std::vector<uint8_t>& input, const uint32_t basis_size)
+namespace
 {
-    assert(input.size() == space.size());
-    std::vector<uint8_t> half = zeroes(basis_size);
+    using namespace jans::gf2solver;
 
-    #pragma omp parallel
+    /*
+        Select the columns s (dim of them, the ones not in last_s first) for which the submatrix of the
+        symmetric t is invertible, and return its inverse in winv (zero outside the selected columns).
+        Returns dim, or 0 if the iteration broke down.
+    */
+    uint32_t find_nonsingular(const uint64_t * t, uint32_t * s, const uint32_t * last_s, const uint32_t last_dim, uint64_t * winv)
     {
-        std::vector<uint8_t> temp = zeroes(basis_size);
-
-        #pragma omp for schedule(static)
-        for (uint32_t space_idx = 0U; space_idx < space.size(); ++space_idx)
+        uint64_t matrix[64][2]; // [ t | I ]
+        for (uint32_t row = 0U; row < 64U; ++row)
         {
-            const sparse_vector& vec = space[space_idx];
-            for (const uint32_t basis_idx : vec)
-            {
-                temp[basis_idx] ^= input[space_idx];
-            }
+            matrix[row][0] = t[row];
+            matrix[row][1] = static_cast<uint64_t>(1U) << row;
         }
 
-        #pragma omp critical
+        uint64_t mask = 0U;
+        for (uint32_t idx = 0U; idx < last_dim; ++idx)
         {
-            for (uint32_t basis_idx = 0; basis_idx < basis_size; ++basis_idx)
+            mask |= static_cast<uint64_t>(1U) << last_s[idx];
+            s[63U - idx] = last_s[idx];
+        }
+        for (uint32_t col = 0U, idx = 0U; col < 64U; ++col)
+        {
+            if (!((mask >> col) & 1U))
             {
-                half[basis_idx] ^= temp[basis_idx];
+                s[idx++] = col;
             }
         }
-    }
 
-    return half;
-}
+        uint32_t dim = 0U;
+        for (uint32_t idx = 0U; idx < 64U; ++idx)
+        {
+            const uint64_t bit = static_cast<uint64_t>(1U) << s[idx];
+            uint64_t * row_i = matrix[s[idx]];
 
+            uint32_t other = idx;
+            while ((other < 64U) && !(matrix[s[other]][0] & bit))
+            {
+                ++other;
+            }
+            if (other < 64U)
+            {
+                std::swap(matrix[s[other]][0], row_i[0]);
+                std::swap(matrix[s[other]][1], row_i[1]);
+                for (uint32_t row = 0U; row < 64U; ++row)
+                {
+                    uint64_t * row_j = matrix[s[row]];
+                    if ((row_j != row_i) && (row_j[0] & bit))
+                    {
+                        row_j[0] ^= row_i[0];
+                        row_j[1] ^= row_i[1];
+                    }
+                }
+                s[dim++] = s[idx];
+                continue;
+            }
 
-/*
-    Return output[space_idx, bit] = sum_{basis_idx} space[space_idx][basis_idx] * half[basis_idx, bit]
-*/
-std::vector<uint8_t> jans::gfsolver::second_half(const std::vector<sparse_vector>& space, const std::vector<uint8_t>& half, const uint32_t basis_size)
-{
-    assert(half.size() == basis_size);
-    std::vector<uint8_t> output = zeroes(space.size());
+            // No pivot in t: use the right-hand half to drop column s[idx]
+            other = idx;
+            while ((other < 64U) && !(matrix[s[other]][1] & bit))
+            {
+                ++other;
+            }
+            if (other == 64U)
+            {
+                return 0U;
+            }
+            std::swap(matrix[s[other]][0], row_i[0]);
+            std::swap(matrix[s[other]][1], row_i[1]);
+            for (uint32_t row = 0U; row < 64U; ++row)
+            {
+                uint64_t * row_j = matrix[s[row]];
+                if ((row_j != row_i) && (row_j[1] & bit))
+                {
+                    row_j[0] ^= row_i[0];
+                    row_j[1] ^= row_i[1];
+                }
+            }
+            row_i[0] = 0U;
+            row_i[1] = 0U;
+        }
 
-    #pragma omp parallel for schedule(static)
-    for (uint32_t space_idx = 0; space_idx < space.size(); ++space_idx)
-    {
-        const sparse_vector& vec = space[space_idx];
-        for (const uint32_t basis_idx : vec)
+        for (uint32_t row = 0U; row < 64U; ++row)
         {
-            output[space_idx] ^= half[basis_idx];
+            winv[row] = matrix[row][1];
         }
+        return dim;
     }
-    return output;
-}
-
-/*
-    Return output[space_idx, bit] = space^T * space * input[space_idx, bit]
-*/
-std::vector<uint8_t> jans::gf2solver::matvec(const std::vector<sparse_vector>& space, const std::vector<uint8_t>& input, const uint32_t basis_size)
-{
-    std::vector<uint8_t> half   =  first_half(space, input, basis_size);
-    std::vector<uint8_t> output = second_half(space, half,  basis_size);
-    return output;
-}
 
-/*
-    Update x: TODO: bitwise
-*/
-bool jans::gf2solver::update_x(std::vector<uint8_t>& x, const std::vector<uint8_t>& v, const std::vector<uint8_t>& Av, const std::vector<uint8_t>& b)
-{
-    const uint8_t denominator = dotproduct(v, Av);
-    if (denominator == 0U)
-    {
-        return true; // Found solution!
-    }
-    const uint8_t numerator = dotproduct(v, b);
-    assert(x.size() == v.size());
-    if (numerator)
+    /*
+        One block Lanczos run from a random start: returns false on breakdown
+    */
+    bool block_lanczos(const sparse_matrix& matrix, std::mt19937_64& gen, std::vector<std::vector<uint32_t>>& nullspace)
     {
-        for (uint32_t idx = 0; idx < v.size(); ++idx)
+        const uint32_t n = matrix.cols();
+        block half(matrix.rows());
+
+        // A x = A x_random is solved for x, hence x (which starts at x_random) ends up in the nullspace of A
+        block x(n);
+        for (uint32_t idx = 0U; idx < n; ++idx)
         {
-            x[idx] ^= v[idx];
+            x[idx] = gen();
         }
-    }
-    return false;
-}
-
-/*
-    Compute new v and shift down: TODO: bitwise
-*/
-void jans::gf2solver::update_v(std::vector<uint8_t>& Av1, std::vector<uint8_t>& v1, std::vector<uint8_t>& Av2, std::vector<uint8_t>& v2)
-{
-    const uint8_t c1 = dotproduct(Av1, Av1); // denominator 1 as algo not yet stopped :-)
-    const uint8_t c2 = dotproduct(Av2, Av1); // denominator 1 as algo not yet stopped :-)
+        block v0(n);
+        matrix.multiply_symmetric(x, half, v0);
+        const block rhs = v0;
+        block v1(n, 0U);
+        block v2(n, 0U);
+        block vnext(n);
 
-    std::vector<uint8_t> v0 = std::copy(Av1);
-    if (c1)
-    {
-        for (uint32_t idx = 0U; idx < v0.size(); ++idx)
+        uint64_t vt_a_v[2][64]  = {};
+        uint64_t vt_a2_v[2][64] = {};
+        uint64_t winv[3][64]    = {};
+        uint64_t d[64], e[64], f[64], f2[64];
+        uint32_t s[2][64];
+        for (uint32_t col = 0U; col < 64U; ++col)
         {
-            v0[idx] ^= v1[idx];
+            s[1][col] = col;
         }
-    }
-    if (c2)
-    {
-        for (uint32_t idx = 0U; idx < v0.size(); ++idx)
+        uint32_t dim1 = 64U;
+        uint64_t mask1 = ~static_cast<uint64_t>(0U);
+
+        const uint32_t max_iter = n / 60U + 64U; // Expected: n / 63.2
+        uint32_t iter = 0U;
+        while (true)
         {
-            v0[idx] ^= v2[idx];
+            if (++iter > max_iter)
+            {
+                return false;
+            }
+
+            matrix.multiply_symmetric(v0, half, vnext);
+            mul_transpose(v0, vnext, vt_a_v[0]);
+            mul_transpose(vnext, vnext, vt_a2_v[0]);
+
+            if (std::all_of(vt_a_v[0], vt_a_v[0] + 64, [](const uint64_t word){ return word == 0U; }))
+            {
+                break;
+            }
+
+            const uint32_t dim0 = find_nonsingular(vt_a_v[0], s[0], s[1], dim1, winv[0]);
+            if (dim0 == 0U)
+            {
+                return false;
+            }
+            uint64_t mask0 = 0U;
+            for (uint32_t idx = 0U; idx < dim0; ++idx)
+            {
+                mask0 |= static_cast<uint64_t>(1U) << s[0][idx];
+            }
+
+            // d = I + winv_0 ( vAAv_0 S_0 S_0^T + vAv_0 )
+            for (uint32_t row = 0U; row < 64U; ++row)
+            {
+                d[row] = (vt_a2_v[0][row] & mask0) ^ vt_a_v[0][row];
+            }
+            mul_64x64(winv[0], d, d);
+            for (uint32_t row = 0U; row < 64U; ++row)
+            {
+                d[row] ^= static_cast<uint64_t>(1U) << row;
+            }
+
+            // e = winv_1 vAv_0 S_0 S_0^T
+            mul_64x64(winv[1], vt_a_v[0], e);
+            for (uint32_t row = 0U; row < 64U; ++row)
+            {
+                e[row] &= mask0;
+            }
+
+            // f = winv_2 ( I + vAv_1 winv_1 ) ( vAAv_1 S_1 S_1^T + vAv_1 ) S_0 S_0^T
+            mul_64x64(vt_a_v[1], winv[1], f);
+            for (uint32_t row = 0U; row < 64U; ++row)
+            {
+                f[row] ^= static_cast<uint64_t>(1U) << row;
+            }
+            mul_64x64(winv[2], f, f);
+            for (uint32_t row = 0U; row < 64U; ++row)
+            {
+                f2[row] = ((vt_a2_v[1][row] & mask1) ^ vt_a_v[1][row]) & mask0;
+            }
+            mul_64x64(f, f2, f);
+
+            // v_next = A v_0 S_0 S_0^T + v_0 d + v_1 e + v_2 f
+            for (uint32_t idx = 0U; idx < n; ++idx)
+            {
+                vnext[idx] &= mask0;
+            }
+            mul_accumulate(v0, d, vnext);
+            mul_accumulate(v1, e, vnext);
+            mul_accumulate(v2, f, vnext);
+
+            // x += v_0 winv_0 v_0^T rhs
+            mul_transpose(v0, rhs, d);
+            mul_64x64(winv[0], d, d);
+            mul_accumulate(v0, d, x);
+
+            v2.swap(v1);
+            v1.swap(v0);
+            v0.swap(vnext);
+            std::copy(winv[1], winv[1] + 64, winv[2]);
+            std::copy(winv[0], winv[0] + 64, winv[1]);
+            std::copy(vt_a_v[0], vt_a_v[0] + 64, vt_a_v[1]);
+            std::copy(vt_a2_v[0], vt_a2_v[0] + 64, vt_a2_v[1]);
+            std::copy(s[0], s[0] + 64, s[1]);
+            mask1 = mask0;
+            dim1 = dim0;
         }
+
+        nullspace = combine(matrix, x, v0);
+        return !nullspace.empty();
     }
-    v2.swap(v1);
-    Av2.swap(Av1);
-    v1.swap(v0);
 }
 
 /*
     Returns std::vector<nullvector>, with nullvector = { index : XOR_index( space[index] ) == null_vector }
-    TODO: bitwise and block_lanczos...
+    Restarts from another random vector on breakdown, and falls back to Gaussian elimination if that keeps failing.
 */
 std::vector<std::vector<uint32_t>> jans::gf2solver::lanczos(const std::vector<sparse_vector>& space, const uint32_t basis_size)
 {
-    const std::vector<uint32_t> contributions = basis_contributions(space, basis_size);
-
-    const std::vector<uint8_t> y_rand = random(space.size());
-    const std::vector<uint8_t> b_vec  = matvec(space, y_rand, basis_size);
-
-    std::vector<uint8_t>   x = zeroes(space.size());
-    std::vector<uint8_t>  v1 = std::copy(b_vec);
-    std::vector<uint8_t> Av1 = matvec(space, vi, basis_size);
-    std::vector<uint8_t>  v2 = zeroes(space.size());
-    std::vector<uint8_t> Av2 = zeroes(space.size());
-    while (!update_x(x, v1, Av1, b))
-    {
-        update_v(Av1, v1, Av2, v2);
-        Av1 = matvec(space, v1, basis_size);
-    }
-
-    // Two null vectors in the end:
-    v1;
-    for (uint32_t idx = 0; idx < v2.size(); ++idx)
-    {
-        v2[idx] = x[idx] ^ y_rand[idx];
-    }
-
-    Here be test whether in nullspace :-)
-
-    std::cout << "jans::gf2solver::lanczos: Found 2 vectors in the nullspace." << std::endl;
+    const sparse_matrix matrix(space, basis_size);
+    std::random_device rd;
+    std::mt19937_64 gen(rd());
 
-    std::vector<std::vector<uint32_t>> nullspace;
-    for (uint32_t sol = start; sol < d_vec; ++sol)
+    for (uint32_t attempt = 0U; attempt < LANCZOS_ATTEMPTS; ++attempt)
     {
-        std::vector<uint32_t> nullvector;
-        for (uint32_t row = d_bas; row < d_row; ++row){
-            if ((matrix[(row >> 3U) + X_row * sol] >> (row & 7U)) & static_cast<uint8_t>(1U))
-            {
-                // item (of list) = row - d_bas
-                nullvector.push_back(row - d_bas);
-            }
+        std::vector<std::vector<uint32_t>> nullspace;
+        if (block_lanczos(matrix, gen, nullspace))
+        {
+            std::cout << "jans::gf2solver::lanczos: Found " << nullspace.size() << " vectors in the nullspace." << std::endl;
+            return nullspace;
         }
-        nullspace.push_back(nullvector);
     }
 
-    delete [] matrix;
-
-    return nullspace;
+    std::cout << "jans::gf2solver::lanczos: No convergence after " << LANCZOS_ATTEMPTS << " attempts, switching to Gaussian elimination." << std::endl;
+    return structured_gaussian(space, basis_size);
 }
-
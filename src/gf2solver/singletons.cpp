@@ -0,0 +1,96 @@
+/*
+   JANS: just another number sieve
+   Copyright (C) 2018-2020 Sebastian Wouters
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include <stdio.h>
+#include <iostream>
+#include <algorithm>
+
+#include "gf2solver.h"
+
+/*
+    Returns the indices of sparse_vectors in space which remain after iterative singleton removal:
+    a basis_index which occurs in exactly one sparse_vector cannot be cancelled, so that sparse_vector
+    cannot contribute to the nullspace. Removing it can create new singletons, hence repeat until none
+    are left. Sets num_active to the number of basis_indices which occur in the remaining sparse_vectors.
+    Linear in the number of nonzeros of space.
+*/
+std::vector<uint32_t> jans::gf2solver::remove_singletons(const std::vector<sparse_vector>& space, const uint32_t basis_size, uint32_t& num_active)
+{
+    std::vector<uint32_t> weight(basis_size, 0U);
+    std::vector<uint32_t> sum_idx(basis_size, 0U); // Sum of the space indices containing basis_idx: the last one if weight == 1
+    for (uint32_t space_idx = 0U; space_idx < space.size(); ++space_idx)
+    {
+        for (const uint32_t basis_idx : space[space_idx])
+        {
+            ++weight[basis_idx];
+            sum_idx[basis_idx] += space_idx;
+        }
+    }
+
+    std::vector<uint8_t> removed(space.size(), 0U);
+    std::vector<uint32_t> singletons;
+    for (uint32_t basis_idx = 0U; basis_idx < basis_size; ++basis_idx)
+    {
+        if (weight[basis_idx] == 1U)
+        {
+            singletons.push_back(basis_idx);
+        }
+    }
+
+    while (!singletons.empty())
+    {
+        const uint32_t basis_idx = singletons.back();
+        singletons.pop_back();
+        if (weight[basis_idx] != 1U)
+        {
+            continue; // Meanwhile emptied
+        }
+        const uint32_t space_idx = sum_idx[basis_idx];
+        removed[space_idx] = 1U;
+        for (const uint32_t other : space[space_idx])
+        {
+            --weight[other];
+            sum_idx[other] -= space_idx;
+            if (weight[other] == 1U)
+            {
+                singletons.push_back(other);
+            }
+        }
+    }
+
+    num_active = 0U;
+    for (uint32_t basis_idx = 0U; basis_idx < basis_size; ++basis_idx)
+    {
+        if (weight[basis_idx] > 0U)
+        {
+            ++num_active;
+        }
+    }
+
+    std::vector<uint32_t> relevant;
+    relevant.reserve(space.size());
+    for (uint32_t space_idx = 0U; space_idx < space.size(); ++space_idx)
+    {
+        if (!removed[space_idx])
+        {
+            relevant.push_back(space_idx);
+        }
+    }
+    return relevant;
+}
@@ -0,0 +1,123 @@
+/*
+   JANS: just another number sieve
+   Copyright (C) 2018-2020 Sebastian Wouters
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+#include <assert.h>
+#include <algorithm>
+
+#include "sparse_matrix.h"
+
+jans::gf2solver::sparse_matrix::sparse_matrix(const std::vector<std::vector<uint32_t>>& space, const uint32_t num_rows) :
+    num_rows(num_rows), num_cols(space.size())
+{
+    // B^T has the sparse_vectors as its rows
+    build(space, num_cols, num_rows, offsets_t, indices_t);
+
+    std::vector<std::vector<uint32_t>> transpose(num_rows);
+    for (uint32_t col = 0U; col < num_cols; ++col)
+    {
+        for (const uint32_t row : space[col])
+        {
+            assert(row < num_rows);
+            transpose[row].push_back(col);
+        }
+    }
+    build(transpose, num_rows, num_cols, offsets, indices);
+}
+
+/*
+    Lay out lists[ out ] ( sorted or not ) stripe by stripe: entries with in in [ stripe * STRIPE_WIDTH, ( stripe + 1 ) * STRIPE_WIDTH [
+*/
+void jans::gf2solver::sparse_matrix::build(const std::vector<std::vector<uint32_t>>& lists, const uint32_t num_out, const uint32_t num_in, std::vector<uint64_t>& offsets, std::vector<uint32_t>& indices)
+{
+    const uint32_t num_stripes = std::max(1U, (num_in + STRIPE_WIDTH - 1U) / STRIPE_WIDTH);
+    offsets.assign(static_cast<uint64_t>(num_stripes) * (num_out + 1U), 0U);
+
+    uint64_t total = 0U;
+    for (const std::vector<uint32_t>& list : lists) { total += list.size(); }
+    indices.clear();
+    indices.reserve(total);
+
+    for (uint32_t stripe = 0U; stripe < num_stripes; ++stripe)
+    {
+        const uint32_t first = stripe * STRIPE_WIDTH;
+        const uint32_t last  = first + STRIPE_WIDTH;
+        uint64_t * stripe_offsets = offsets.data() + static_cast<uint64_t>(stripe) * (num_out + 1U);
+        for (uint32_t out = 0U; out < num_out; ++out)
+        {
+            stripe_offsets[out] = indices.size();
+            for (const uint32_t in : lists[out])
+            {
+                if ((in >= first) && (in < last))
+                {
+                    indices.push_back(in);
+                }
+            }
+        }
+        stripe_offsets[num_out] = indices.size();
+    }
+}
+
+/*
+    output[ out ] = XOR_{ in in row out } input[ in ]: parallel over chunks of ROW_CHUNK output rows, stripes innermost per chunk
+*/
+void jans::gf2solver::sparse_matrix::apply(const std::vector<uint64_t>& offsets, const std::vector<uint32_t>& indices, const uint32_t num_out, const uint32_t num_in, const std::vector<uint64_t>& input, std::vector<uint64_t>& output)
+{
+    assert(input.size() >= num_in);
+    assert(output.size() >= num_out);
+    const uint32_t num_stripes = offsets.size() / (num_out + 1U);
+    const uint32_t num_chunks  = (num_out + ROW_CHUNK - 1U) / ROW_CHUNK;
+
+    #pragma omp parallel for schedule(dynamic)
+    for (uint32_t chunk = 0U; chunk < num_chunks; ++chunk)
+    {
+        const uint32_t first = chunk * ROW_CHUNK;
+        const uint32_t last  = std::min(first + ROW_CHUNK, num_out);
+        std::fill(output.begin() + first, output.begin() + last, 0U);
+        for (uint32_t stripe = 0U; stripe < num_stripes; ++stripe)
+        {
+            const uint64_t * stripe_offsets = offsets.data() + static_cast<uint64_t>(stripe) * (num_out + 1U);
+            for (uint32_t out = first; out < last; ++out)
+            {
+                uint64_t word = 0U;
+                for (uint64_t idx = stripe_offsets[out]; idx < stripe_offsets[out + 1U]; ++idx)
+                {
+                    word ^= input[indices[idx]];
+                }
+                output[out] ^= word;
+            }
+        }
+    }
+}
+
+void jans::gf2solver::sparse_matrix::multiply(const std::vector<uint64_t>& input, std::vector<uint64_t>& output) const
+{
+    apply(offsets, indices, num_rows, num_cols, input, output);
+}
+
+void jans::gf2solver::sparse_matrix::multiply_transpose(const std::vector<uint64_t>& input, std::vector<uint64_t>& output) const
+{
+    apply(offsets_t, indices_t, num_cols, num_rows, input, output);
+}
+
+void jans::gf2solver::sparse_matrix::multiply_symmetric(const std::vector<uint64_t>& input, std::vector<uint64_t>& half, std::vector<uint64_t>& output) const
+{
+    multiply(input, half);
+    multiply_transpose(half, output);
+}
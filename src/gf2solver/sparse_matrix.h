@@ -0,0 +1,82 @@
+/*
+   JANS: just another number sieve
+   Copyright (C) 2018-2020 Sebastian Wouters
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#define STRIPE_WIDTH 16384 // Input words per stripe: 128 kB of the input block stays in cache
+#define ROW_CHUNK    256   // Output rows per parallel task
+
+namespace jans {
+
+    namespace gf2solver
+    {
+        /*
+            Sparse matrix B over GF(2) of num_rows x num_cols, with the sparse_vectors of space as its columns.
+            Both B (CSR) and B^T (CSR of the transpose, i.e. CSC of B) are stored contiguously, split in stripes
+            of STRIPE_WIDTH input indices, so that the multiplications with a block of 64 vectors (one uint64_t
+            per row) read a cache-sized part of the input per stripe. Threads own disjoint ranges of output rows,
+            hence no critical sections or reductions are needed.
+         */
+        class sparse_matrix
+        {
+            public:
+
+                sparse_matrix(const std::vector<std::vector<uint32_t>>& space, const uint32_t num_rows);
+
+                uint32_t rows() const { return num_rows; }
+
+                uint32_t cols() const { return num_cols; }
+
+                uint64_t nonzeros() const { return indices_t.size(); }
+
+                // output = B * input (output: num_rows words, input: num_cols words)
+                void multiply(const std::vector<uint64_t>& input, std::vector<uint64_t>& output) const;
+
+                // output = B^T * input (output: num_cols words, input: num_rows words)
+                void multiply_transpose(const std::vector<uint64_t>& input, std::vector<uint64_t>& output) const;
+
+                // output = B^T * B * input, with half (num_rows words) as workspace
+                void multiply_symmetric(const std::vector<uint64_t>& input, std::vector<uint64_t>& half, std::vector<uint64_t>& output) const;
+
+            private:
+
+                uint32_t num_rows;
+
+                uint32_t num_cols;
+
+                // B: offsets[ stripe * ( num_rows + 1 ) + row ] into indices, per stripe of columns
+                std::vector<uint64_t> offsets;
+
+                std::vector<uint32_t> indices;
+
+                // B^T: offsets_t[ stripe * ( num_cols + 1 ) + col ] into indices_t, per stripe of rows
+                std::vector<uint64_t> offsets_t;
+
+                std::vector<uint32_t> indices_t;
+
+                static void build(const std::vector<std::vector<uint32_t>>& lists, const uint32_t num_out, const uint32_t num_in, std::vector<uint64_t>& offsets, std::vector<uint32_t>& indices);
+
+                static void apply(const std::vector<uint64_t>& offsets, const std::vector<uint32_t>& indices, const uint32_t num_out, const uint32_t num_in, const std::vector<uint64_t>& input, std::vector<uint64_t>& output);
+        };
+    }
+}
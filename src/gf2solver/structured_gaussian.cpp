@@ -0,0 +1,201 @@
+/*
+   JANS: just another number sieve
+   Copyright (C) 2018-2020 Sebastian Wouters
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+#include <stdio.h>
+#include <iostream>
+#include <algorithm>
+#include <queue>
+
+#include "gf2solver.h"
+
+#define SGE_MAX_WEIGHT 16 // Only basis_indices in at most this many sparse_vectors are eliminated sparsely
+
+namespace
+{
+    using entry = std::pair<uint64_t, uint32_t>; // ( Markowitz cost, basis_index )
+
+    void symmetric_difference(std::vector<uint32_t>& target, const std::vector<uint32_t>& source)
+    {
+        std::vector<uint32_t> result;
+        result.reserve(target.size() + source.size());
+        std::set_symmetric_difference(target.begin(), target.end(), source.begin(), source.end(), std::back_inserter(result));
+        target.swap(result);
+    }
+}
+
+/*
+    Returns std::vector<nullvector>, with nullvector = { index : XOR_index( space[index] ) == null_vector }
+*/
+std::vector<std::vector<uint32_t>> jans::gf2solver::structured_gaussian(const std::vector<sparse_vector>& space, const uint32_t basis_size, const std::string& scratch)
+{
+    std::vector<std::vector<uint32_t>> nullspace;
+    structured_gaussian(space, basis_size, [&nullspace](const std::vector<uint32_t>& nullvector){ nullspace.push_back(nullvector); return false; }, scratch);
+    return nullspace;
+}
+
+/*
+    Hands every nullvector = { index : XOR_index( space[index] ) == null_vector } to sink, until sink returns true
+
+    Structured Gaussian elimination: basis_indices of low weight are eliminated while space stays sparse. Per step the
+    basis_index with the lowest Markowitz cost ( weight - 1 ) x ( lightest sparse_vector containing it - 1 ) is taken,
+    that lightest sparse_vector is added to the others containing the basis_index and then dropped. Basis_indices of weight
+    one drop their sparse_vector for free. Once every remaining basis_index is heavier than SGE_MAX_WEIGHT, only the small
+    dense core is handed to the word-packed gaussian ( out-of-core with a scratch directory ), and its nullvectors are
+    mapped back through the row compositions as they come.
+*/
+void jans::gf2solver::structured_gaussian(const std::vector<sparse_vector>& space, const uint32_t basis_size, const nullvector_sink& sink, const std::string& scratch)
+{
+    std::vector<sparse_vector> rows(space);
+    std::vector<std::vector<uint32_t>> composition(space.size());
+    std::vector<uint8_t> alive(space.size(), 1U);
+    std::vector<std::vector<uint32_t>> col_rows(basis_size); // May hold stale rows: checked on use
+    std::vector<uint32_t> weight(basis_size, 0U);
+    uint64_t nonzeros = 0U;
+    for (uint32_t row = 0U; row < rows.size(); ++row)
+    {
+        composition[row].push_back(row);
+        nonzeros += rows[row].size();
+        for (const uint32_t basis_idx : rows[row])
+        {
+            ++weight[basis_idx];
+            col_rows[basis_idx].push_back(row);
+        }
+    }
+    const uint32_t start_cols = std::count_if(weight.begin(), weight.end(), [](const uint32_t w){ return w > 0U; });
+
+    auto contains = [&rows](const uint32_t row, const uint32_t basis_idx){ return std::binary_search(rows[row].begin(), rows[row].end(), basis_idx); };
+    auto refresh = [&](const uint32_t basis_idx)
+    {
+        std::vector<uint32_t>& list = col_rows[basis_idx];
+        std::sort(list.begin(), list.end());
+        list.erase(std::unique(list.begin(), list.end()), list.end());
+        list.erase(std::remove_if(list.begin(), list.end(), [&](const uint32_t row){ return (!alive[row]) || (!contains(row, basis_idx)); }), list.end());
+    };
+    auto cost = [&](const uint32_t basis_idx, uint32_t& pivot)
+    {
+        pivot = col_rows[basis_idx][0];
+        for (const uint32_t row : col_rows[basis_idx])
+        {
+            if (rows[row].size() < rows[pivot].size()) { pivot = row; }
+        }
+        return static_cast<uint64_t>(weight[basis_idx] - 1U) * static_cast<uint64_t>(rows[pivot].size() - 1U);
+    };
+    auto drop = [&](const uint32_t row)
+    {
+        alive[row] = 0U;
+        for (const uint32_t basis_idx : rows[row]) { --weight[basis_idx]; }
+    };
+
+    std::priority_queue<entry, std::vector<entry>, std::greater<entry>> queue;
+    for (uint32_t basis_idx = 0U; basis_idx < basis_size; ++basis_idx)
+    {
+        if ((weight[basis_idx] > 0U) && (weight[basis_idx] <= SGE_MAX_WEIGHT))
+        {
+            refresh(basis_idx);
+            uint32_t pivot = 0U;
+            queue.push(std::make_pair(cost(basis_idx, pivot), basis_idx));
+        }
+    }
+
+    uint32_t eliminated = 0U;
+    while (!queue.empty())
+    {
+        const entry top = queue.top();
+        queue.pop();
+        const uint32_t basis_idx = top.second;
+        if ((weight[basis_idx] == 0U) || (weight[basis_idx] > SGE_MAX_WEIGHT)) { continue; }
+        refresh(basis_idx);
+        uint32_t pivot = 0U;
+        const uint64_t current = cost(basis_idx, pivot);
+        if (current != top.first)
+        {
+            queue.push(std::make_pair(current, basis_idx)); // Stale cost
+            continue;
+        }
+
+        const sparse_vector pivot_row = rows[pivot];
+        for (const uint32_t row : col_rows[basis_idx])
+        {
+            if (row == pivot) { continue; }
+            for (const uint32_t other : pivot_row)
+            {
+                if (contains(row, other)) { --weight[other]; }
+                else
+                {
+                    ++weight[other];
+                    col_rows[other].push_back(row);
+                }
+            }
+            symmetric_difference(rows[row], pivot_row);
+            symmetric_difference(composition[row], composition[pivot]);
+        }
+        drop(pivot);
+        ++eliminated;
+
+        // The weights of the other basis_indices of the pivot changed
+        for (const uint32_t other : pivot_row)
+        {
+            if ((weight[other] > 0U) && (weight[other] <= SGE_MAX_WEIGHT))
+            {
+                refresh(other);
+                uint32_t other_pivot = 0U;
+                queue.push(std::make_pair(cost(other, other_pivot), other));
+            }
+        }
+    }
+
+    std::vector<sparse_vector> core;
+    std::vector<uint32_t> core_rows;
+    uint64_t core_nonzeros = 0U;
+    for (uint32_t row = 0U; row < rows.size(); ++row)
+    {
+        if (alive[row])
+        {
+            core.push_back(rows[row]);
+            core_rows.push_back(row);
+            core_nonzeros += rows[row].size();
+        }
+    }
+    const uint32_t core_cols = std::count_if(weight.begin(), weight.end(), [](const uint32_t w){ return w > 0U; });
+    std::cout << "jans::gf2solver::structured_gaussian: Eliminated " << eliminated << " basis indices sparsely: dense core of "
+              << core.size() << " x " << core_cols << " with " << core_nonzeros << " nonzeros (from " << space.size() << " x "
+              << start_cols << " with " << nonzeros << " nonzeros)." << std::endl;
+
+    // Compositions overlap after elimination: map back with the parity of every index in space
+    std::vector<uint8_t> parity(space.size(), 0U);
+    std::vector<uint32_t> nullvector;
+    gaussian(core, basis_size, [&](const std::vector<uint32_t>& core_vector)
+    {
+        for (const uint32_t idx : core_vector)
+        {
+            for (const uint32_t original : composition[core_rows[idx]]) { parity[original] ^= 1U; }
+        }
+        nullvector.clear();
+        for (uint32_t original = 0U; original < space.size(); ++original)
+        {
+            if (parity[original])
+            {
+                nullvector.push_back(original);
+                parity[original] = 0U;
+            }
+        }
+        return ((!nullvector.empty()) && sink(nullvector));
+    }, scratch);
+}
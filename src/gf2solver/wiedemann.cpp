@@ -0,0 +1,390 @@
+/*
+   JANS: just another number sieve
+   Copyright (C) 2018-2020 Sebastian Wouters
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+#include <stdio.h>
+#include <iostream>
+#include <algorithm>
+#include <numeric>
+#include <random>
+#ifdef _OPENMP
+    #include <omp.h>
+#endif
+
+#include "gf2solver.h"
+
+#define WIEDEMANN_ATTEMPTS 4
+#define WIEDEMANN_CHUNKS   8  // Maximum number of independent Krylov sequences
+#define WIEDEMANN_MARGIN   8  // Extra sequence terms
+
+/*
+    Coppersmith's block Wiedemann over GF(2).
+
+    The rows of B which occur are renumbered, so that B becomes a square n x n matrix C (n = space.size()).
+    With random blocks X and Y_1 ... Y_S (64 columns each), every chunk s independently computes the Krylov
+    sequence a_k^(s) = X^T C^k Z_s with Z_s = C Y_s for k < L: the chunks do not communicate, and run in parallel.
+    A matrix Berlekamp-Massey step (an order basis of [ A(x) | I ] with A(x) = sum_k a_k x^k) then yields
+    polynomial vectors g with deg g <= d and X^T C^i ( sum_k C^(d-k) Z g_k ) = 0 for all i <= L-1-d, so that
+    w = sum_k C^(d-k) Y g_k is (mostly) a nullvector of C.
+*/
+
+namespace
+{
+    using namespace jans::gf2solver;
+
+    /*
+        Order basis of [ A(x) | I ] mod x^L for the sequence seq[k][s] = a_k^(s) (64 x 64 each): columns
+        j < 64 S start as unit vectors of the g part with delta 0, columns j >= 64 S as unit vectors of the
+        r part with delta 1. Per step, the lowest coefficient of the residual is eliminated with columns of
+        lower delta; the pivot columns are multiplied by x. Returns the g part poly[k] (64 S rows of cw
+        words per coefficient) and the delta per column.
+    */
+    void berlekamp_massey(const std::vector<block>& seq, const uint32_t chunks, std::vector<uint64_t>& poly, std::vector<uint32_t>& delta)
+    {
+        const uint32_t L     = seq.size();
+        const uint32_t nrows = 64U * chunks;         // Components of g
+        const uint32_t ncols = 64U * (chunks + 1U);  // Columns of the basis
+        const uint32_t cw    = chunks + 1U;          // Words per row
+
+        // residual[k] = coefficient k of [ A | I ] P / x^t: 64 rows of cw words
+        std::vector<uint64_t> residual(static_cast<uint64_t>(L) * 64U * cw, 0U);
+        for (uint32_t k = 0U; k < L; ++k)
+        {
+            for (uint32_t row = 0U; row < 64U; ++row)
+            {
+                for (uint32_t s = 0U; s < chunks; ++s)
+                {
+                    residual[(k * 64U + row) * cw + s] = seq[k][64U * s + row];
+                }
+            }
+        }
+        for (uint32_t row = 0U; row < 64U; ++row)
+        {
+            residual[row * cw + chunks] = static_cast<uint64_t>(1U) << row;
+        }
+        uint32_t length = L;
+
+        poly.assign(static_cast<uint64_t>(nrows) * cw, 0U);
+        for (uint32_t row = 0U; row < nrows; ++row)
+        {
+            poly[row * cw + (row >> 6U)] = static_cast<uint64_t>(1U) << (row & 63U);
+        }
+        uint32_t degree = 1U; // Number of coefficients in poly
+        delta.assign(ncols, 0U);
+        std::fill(delta.begin() + nrows, delta.end(), 1U);
+
+        std::vector<uint64_t> column(ncols);
+        std::vector<uint64_t> transform(static_cast<uint64_t>(ncols) * cw); // Column j of T
+        std::vector<uint64_t> rows(static_cast<uint64_t>(ncols) * cw);      // Row i of T
+        std::vector<uint64_t> table(8U * cw * 256U * cw);
+        std::vector<uint64_t> pivot_mask(cw);
+        std::vector<uint64_t> result(cw);
+        std::vector<uint32_t> order(ncols);
+        std::vector<std::pair<uint32_t, uint32_t>> pivots; // ( column, bit )
+
+        for (uint32_t t = 0U; t < L; ++t)
+        {
+            std::fill(column.begin(), column.end(), 0U);
+            for (uint32_t row = 0U; row < 64U; ++row)
+            {
+                for (uint32_t col = 0U; col < ncols; ++col)
+                {
+                    column[col] |= ((residual[row * cw + (col >> 6U)] >> (col & 63U)) & 1U) << row;
+                }
+            }
+
+            std::iota(order.begin(), order.end(), 0U);
+            std::stable_sort(order.begin(), order.end(), [&delta](const uint32_t a, const uint32_t b){ return delta[a] < delta[b]; });
+            std::fill(transform.begin(), transform.end(), 0U);
+            for (uint32_t col = 0U; col < ncols; ++col)
+            {
+                transform[col * cw + (col >> 6U)] = static_cast<uint64_t>(1U) << (col & 63U);
+            }
+            pivots.clear();
+            std::fill(pivot_mask.begin(), pivot_mask.end(), 0U);
+            for (const uint32_t col : order)
+            {
+                for (const std::pair<uint32_t, uint32_t>& pivot : pivots)
+                {
+                    if ((column[col] >> pivot.second) & 1U)
+                    {
+                        column[col] ^= column[pivot.first];
+                        for (uint32_t word = 0U; word < cw; ++word)
+                        {
+                            transform[col * cw + word] ^= transform[pivot.first * cw + word];
+                        }
+                    }
+                }
+                if (column[col] != 0U)
+                {
+                    pivots.push_back(std::make_pair(col, static_cast<uint32_t>(__builtin_ctzll(column[col]))));
+                    pivot_mask[col >> 6U] |= static_cast<uint64_t>(1U) << (col & 63U);
+                    ++delta[col];
+                }
+            }
+
+            // Row i of T, and per byte of a row the XOR of the selected rows of T
+            std::fill(rows.begin(), rows.end(), 0U);
+            for (uint32_t col = 0U; col < ncols; ++col)
+            {
+                for (uint32_t row = 0U; row < ncols; ++row)
+                {
+                    if ((transform[col * cw + (row >> 6U)] >> (row & 63U)) & 1U)
+                    {
+                        rows[row * cw + (col >> 6U)] |= static_cast<uint64_t>(1U) << (col & 63U);
+                    }
+                }
+            }
+            for (uint32_t byte = 0U; byte < 8U * cw; ++byte)
+            {
+                uint64_t * byte_table = table.data() + byte * 256U * cw;
+                std::fill(byte_table, byte_table + cw, 0U);
+                for (uint32_t value = 1U; value < 256U; ++value)
+                {
+                    const uint32_t low = value & (value - 1U);
+                    const uint32_t row = 8U * byte + __builtin_ctz(value);
+                    for (uint32_t word = 0U; word < cw; ++word)
+                    {
+                        byte_table[value * cw + word] = byte_table[low * cw + word] ^ rows[row * cw + word];
+                    }
+                }
+            }
+            auto apply = [&](uint64_t * row)
+            {
+                std::fill(result.begin(), result.end(), 0U);
+                for (uint32_t byte = 0U; byte < 8U * cw; ++byte)
+                {
+                    const uint64_t * entry = table.data() + (byte * 256U + ((row[byte >> 3U] >> (8U * (byte & 7U))) & 255U)) * cw;
+                    for (uint32_t word = 0U; word < cw; ++word)
+                    {
+                        result[word] ^= entry[word];
+                    }
+                }
+                std::copy(result.begin(), result.end(), row);
+            };
+
+            // poly = poly T D and residual = residual T D / x, with D = x on the pivot columns
+            for (uint32_t idx = 0U; idx < degree * nrows; ++idx)
+            {
+                apply(poly.data() + idx * cw);
+            }
+            for (uint32_t idx = 0U; idx < length * 64U; ++idx)
+            {
+                apply(residual.data() + idx * cw);
+            }
+            const uint32_t max_delta = *std::max_element(delta.begin(), delta.begin() + nrows + 64U);
+            if (max_delta + 1U > degree)
+            {
+                poly.resize(static_cast<uint64_t>(max_delta + 1U) * nrows * cw, 0U);
+                degree = max_delta + 1U;
+            }
+            for (uint32_t k = degree - 1U; k > 0U; --k)
+            {
+                for (uint32_t row = 0U; row < nrows; ++row)
+                {
+                    for (uint32_t word = 0U; word < cw; ++word)
+                    {
+                        uint64_t& target = poly[(k * nrows + row) * cw + word];
+                        target = (target & ~pivot_mask[word]) | (poly[((k - 1U) * nrows + row) * cw + word] & pivot_mask[word]);
+                    }
+                }
+            }
+            for (uint32_t row = 0U; row < nrows; ++row)
+            {
+                for (uint32_t word = 0U; word < cw; ++word)
+                {
+                    poly[row * cw + word] &= ~pivot_mask[word];
+                }
+            }
+            for (uint32_t k = 0U; k + 1U < length; ++k)
+            {
+                for (uint32_t row = 0U; row < 64U; ++row)
+                {
+                    for (uint32_t word = 0U; word < cw; ++word)
+                    {
+                        uint64_t& target = residual[(k * 64U + row) * cw + word];
+                        target = (target & pivot_mask[word]) | (residual[((k + 1U) * 64U + row) * cw + word] & ~pivot_mask[word]);
+                    }
+                }
+            }
+            --length;
+        }
+    }
+
+    /*
+        One block Wiedemann run from random X and Y: returns false if no nullvectors were found
+    */
+    bool block_wiedemann(const sparse_matrix& square, const uint32_t chunks, std::mt19937_64& gen, std::vector<std::vector<uint32_t>>& nullspace)
+    {
+        const uint32_t n = square.cols();
+        const uint32_t L = (n + 63U) / 64U + (n + 64U * chunks - 1U) / (64U * chunks) + WIEDEMANN_MARGIN;
+
+        block x(n);
+        std::vector<block> y(chunks, block(n));
+        for (uint32_t idx = 0U; idx < n; ++idx)
+        {
+            x[idx] = gen();
+            for (uint32_t s = 0U; s < chunks; ++s)
+            {
+                y[s][idx] = gen();
+            }
+        }
+
+        // Krylov sequences: seq[k] holds a_k^(s) in words [ 64 s, 64 s + 64 [
+        std::vector<block> seq(L, block(64U * chunks));
+        #pragma omp parallel for schedule(dynamic)
+        for (uint32_t s = 0U; s < chunks; ++s)
+        {
+            block v(n);
+            block next(n);
+            square.multiply(y[s], v);
+            for (uint32_t k = 0U; k < L; ++k)
+            {
+                mul_transpose(x, v, seq[k].data() + 64U * s);
+                square.multiply(v, next);
+                v.swap(next);
+            }
+        }
+
+        std::vector<uint64_t> poly;
+        std::vector<uint32_t> delta;
+        berlekamp_massey(seq, chunks, poly, delta);
+        const uint32_t nrows = 64U * chunks;
+        const uint32_t cw    = chunks + 1U;
+        const uint32_t degree = poly.size() / (nrows * cw);
+
+        // The (at most 64) columns with the lowest delta and a nonzero g
+        std::vector<uint32_t> order(64U * cw);
+        std::iota(order.begin(), order.end(), 0U);
+        std::stable_sort(order.begin(), order.end(), [&delta](const uint32_t a, const uint32_t b){ return delta[a] < delta[b]; });
+        std::vector<uint32_t> chosen;
+        for (const uint32_t col : order)
+        {
+            bool nonzero = false;
+            for (uint32_t k = 0U; (k < degree) && (!nonzero); ++k)
+            {
+                for (uint32_t row = 0U; (row < nrows) && (!nonzero); ++row)
+                {
+                    nonzero = (poly[(k * nrows + row) * cw + (col >> 6U)] >> (col & 63U)) & 1U;
+                }
+            }
+            if (nonzero)
+            {
+                chosen.push_back(col);
+            }
+            if (chosen.size() == 64U) { break; }
+        }
+        if (chosen.empty())
+        {
+            return false;
+        }
+        uint32_t max_delta = 0U;
+        for (const uint32_t col : chosen)
+        {
+            max_delta = std::max(max_delta, delta[col]);
+        }
+
+        // Horner: w = C w + sum_s Y_s G_s, with G_s[i] bit c = component 64 s + i of g_(chosen[c]) at x^( delta - max_delta + step )
+        block w(n, 0U);
+        block next(n);
+        uint64_t g[64];
+        for (uint32_t step = 0U; step <= max_delta; ++step)
+        {
+            square.multiply(w, next);
+            w.swap(next);
+            for (uint32_t s = 0U; s < chunks; ++s)
+            {
+                std::fill(g, g + 64, 0U);
+                for (uint32_t c = 0U; c < chosen.size(); ++c)
+                {
+                    const uint32_t col = chosen[c];
+                    if (step + delta[col] < max_delta)
+                    {
+                        continue;
+                    }
+                    const uint32_t k = step + delta[col] - max_delta;
+                    for (uint32_t i = 0U; i < 64U; ++i)
+                    {
+                        g[i] |= ((poly[(k * nrows + 64U * s + i) * cw + (col >> 6U)] >> (col & 63U)) & 1U) << c;
+                    }
+                }
+                mul_accumulate(y[s], g, w);
+            }
+        }
+
+        block cw_block(n);
+        square.multiply(w, cw_block);
+        nullspace = combine(square, w, cw_block);
+        return !nullspace.empty();
+    }
+}
+
+/*
+    Returns std::vector<nullvector>, with nullvector = { index : XOR_index( space[index] ) == null_vector }
+    Uses one Krylov sequence per thread (at most WIEDEMANN_CHUNKS), restarts from other random blocks if
+    no nullvectors were found, and falls back to Gaussian elimination if that keeps failing.
+*/
+std::vector<std::vector<uint32_t>> jans::gf2solver::wiedemann(const std::vector<sparse_vector>& space, const uint32_t basis_size)
+{
+    std::vector<uint32_t> renumber(basis_size, basis_size);
+    uint32_t num_rows = 0U;
+    std::vector<sparse_vector> renumbered_space;
+    renumbered_space.reserve(space.size());
+    for (const sparse_vector& vec : space)
+    {
+        sparse_vector renumbered;
+        renumbered.reserve(vec.size());
+        for (const uint32_t basis_idx : vec)
+        {
+            if (renumber[basis_idx] == basis_size)
+            {
+                renumber[basis_idx] = num_rows++;
+            }
+            renumbered.push_back(renumber[basis_idx]);
+        }
+        renumbered_space.push_back(renumbered);
+    }
+    if (num_rows > space.size())
+    {
+        std::cout << "jans::gf2solver::wiedemann: More basis indices than space vectors, switching to Gaussian elimination." << std::endl;
+        return structured_gaussian(space, basis_size);
+    }
+
+    uint32_t chunks = 1U;
+    #ifdef _OPENMP
+    chunks = std::min(static_cast<uint32_t>(omp_get_max_threads()), static_cast<uint32_t>(WIEDEMANN_CHUNKS));
+    #endif
+
+    const sparse_matrix square(renumbered_space, space.size());
+    std::random_device rd;
+    std::mt19937_64 gen(rd());
+
+    for (uint32_t attempt = 0U; attempt < WIEDEMANN_ATTEMPTS; ++attempt)
+    {
+        std::vector<std::vector<uint32_t>> nullspace;
+        if (block_wiedemann(square, chunks, gen, nullspace))
+        {
+            std::cout << "jans::gf2solver::wiedemann: Found " << nullspace.size() << " vectors in the nullspace with " << chunks << " Krylov sequence(s)." << std::endl;
+            return nullspace;
+        }
+    }
+
+    std::cout << "jans::gf2solver::wiedemann: No nullvectors after " << WIEDEMANN_ATTEMPTS << " attempts, switching to Gaussian elimination." << std::endl;
+    return structured_gaussian(space, basis_size);
+}
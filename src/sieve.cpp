@@ -24,17 +24,27 @@
 #include <sys/time.h>
 #include <stdio.h>
 #include <iostream>
+#include <sstream>
 #include <math.h>
 #include <stdlib.h>
+#include <chrono>
+#include <unistd.h>
+#include <algorithm>
+#include <map>
 
 #include "sieve.h"
 
-jans::sieve::sieve( jans::big_int & num, const ubase_t factorbound, const ubase_t sievespace, const int congruences ){
+#define POLY_CHUNK 16 // Number of candidate mpqs_q handed out to a thread at once
+
+jans::sieve::sieve( jans::big_int & num, const ubase_t multiplier, const ubase_t factorbound, const ubase_t sievespace, const int congruences ){
 
    //check_bounds_M
    assert( sievespace >= factorbound );
+   assert( multiplier >= 1 );
    this->M = sievespace; // Sieve for x in [-M, M]
-   target.copy( num );
+   this->multiplier = multiplier;
+   number.copy( num );
+   jans::big_int::prod( target, number, multiplier ); // Sieve on k * N, factor N
 
    __startup2__( factorbound ); // Sets num_primes & creates primes, roots, and logvals
 
@@ -42,6 +52,33 @@ jans::sieve::sieve( jans::big_int & num, const ubase_t factorbound, const ubase_
    powspace = num_primes + 1; // Positive and negative Q(x)
    required = powspace + extra;
 
+   const ucarry_t large_max = ( ucarry_t )( LARGE_PRIME_RATIO ) * factorbound; // Large primes fit a ubase_t, so two of them a ucarry_t
+   large_bound = ( ( large_max < __11111111__ ) ? large_max : __11111111__ );
+
+   blocksize = 0;
+   pipeline[ 0 ] = 0;
+   pipeline[ 1 ] = 0;
+   pipeline[ 2 ] = 0;
+   batchsize     = 0;
+   verify        = false;
+   quiet         = false;
+   adaptive      = false;
+   linalg        = LINALG_GAUSSIAN;
+
+   num_shards = 1;
+   #ifdef _OPENMP
+   num_shards = omp_get_max_threads();
+   #endif
+   shards      = new std::vector<smooth_number>[ num_shards ];
+   shard_locks = new std::mutex[ num_shards ];
+   found       = 0;
+   partials    = 0;
+
+   first_poly = 0;
+   last_poly  = __11111111__;
+   listener   = -1;
+   log_fd     = -1;
+
    //lincount = 0;
    //xvalues  = new jans::big_int[ linspace ];
    //pvalues  = new jans::big_int[ linspace ];
@@ -55,6 +92,14 @@ jans::sieve::~sieve(){
    delete [] primes;
    delete [] roots;
    delete [] logval;
+   delete [] shards;
+   delete [] shard_locks;
+
+   if ( log_fd >= 0 ){
+      fsync( log_fd );
+      close( log_fd );
+   }
+   if ( listener >= 0 ){ close( listener ); }
 
    //delete [] xvalues;
    //delete [] pvalues;
@@ -65,14 +110,184 @@ jans::sieve::~sieve(){
 
 }
 
-void jans::sieve::run( jans::big_int & sol_p, jans::big_int & sol_q, const double threshold ){
+void jans::sieve::set_blocksize( const ubase_t blocksize ){
+
+   this->blocksize = blocksize;
+
+}
+
+void jans::sieve::set_verify( const bool verify ){
+
+   this->verify = verify;
+
+}
+
+void jans::sieve::set_adaptive( const bool adaptive ){
+
+   this->adaptive = adaptive;
+
+}
+
+void jans::sieve::set_linalg( const int linalg ){
+
+   this->linalg = linalg;
+
+}
+
+bool jans::sieve::set_scratch( const std::string & directory ){
+
+   // Returns false if no files can be created in the directory
+
+   if ( access( directory.c_str(), W_OK | X_OK ) != 0 ){
+      std::cerr << "   Error: cannot write in the scratch directory " << directory << std::endl;
+      return false;
+   }
+   scratch = directory;
+   return true;
+
+}
+
+void jans::sieve::set_pipeline( const int generators, const int sievers, const int checkers ){
+
+   assert( ( generators >= 0 ) && ( sievers >= 0 ) && ( checkers >= 0 ) );
+   pipeline[ 0 ] = generators;
+   pipeline[ 1 ] = sievers;
+   pipeline[ 2 ] = checkers;
+
+}
+
+bool jans::sieve::run( jans::big_int & sol_p, jans::big_int & sol_q, const double threshold ){
 
-   jans::big_int shared_mpqs_q;
-   __startup1__( shared_mpqs_q ); // Sets initial mpqs_q near ( 2N )^0.25 / sqrt( M )
+   // Returns false if none of the dependencies splits N
+
+   __startup1__( mpqs_q0 ); // Sets initial mpqs_q near ( 2N )^0.25 / sqrt( M )
+   next_poly = first_poly;
+   open_polys.clear(); // Left over by the trial runs of the autotuner
+   control.reset( threshold, adaptive );
 
    struct timeval start, end;
    gettimeofday( &start, NULL );
 
+   __collect_relations__(); // Relations resumed from the log are deduplicated and verified as well
+   int excess = __excess__();
+   while ( excess < extra ){ // Sieve more if the excess does not suffice, e.g. after dropping duplicate or bad relations
+      stop        = ( found >= required );
+      next_filter = std::max( found + partials + extra - excess, required / 2 ); // Every relation increases the excess by at most one
+      if ( listener >= 0 ){ __coordinate__(); }
+      else { __sieve__(); }
+      __collect_relations__();
+      excess = __excess__();
+   }
+   if ( listener >= 0 ){ // The workers which connect from now on are refused by the closed port
+      close( listener );
+      listener = -1;
+   }
+
+   gettimeofday( &end, NULL );
+   double elapsed = ( end.tv_sec - start.tv_sec ) + 1e-6 * ( end.tv_usec - start.tv_usec );
+   std::cout << "Time elapsed for sieving (seconds): " << elapsed << std::endl;
+   if ( adaptive ){ control.report(); }
+   __sync_log__();
+
+   std::unordered_map<uint32_t, uint32_t> large_columns;
+   const std::vector<std::vector<uint32_t>> relations = __gf2sparse__( factorization, num_primes, large_columns );
+   const uint32_t basis_size = 1U + num_primes + large_columns.size();
+   const jans::gf2solver::filtered_space filtered = jans::gf2solver::filter(relations, basis_size, extra + FILTER_EXCESS);
+   const std::vector<std::vector<uint32_t>>& space = filtered.space;
+
+   gettimeofday( &start, NULL );
+   std::string solver;
+   switch ( linalg ){
+      case LINALG_LANCZOS:   solver = "block Lanczos"; break;
+      case LINALG_WIEDEMANN: solver = "block Wiedemann"; break;
+      default:               solver = ( ( scratch.empty() ) ? "Gaussian elimination" : "out-of-core Gaussian elimination" );
+   }
+
+   // The dependencies are tried as they come out of the solver, which stops once one of them splits N
+   ubase_t dependencies = 0;
+   bool    factored     = false;
+   const jans::nullvector_sink sink = [ & ]( const std::vector<uint32_t> & nullvector ){
+      if ( dependencies++ == 0 ){
+         gettimeofday( &end, NULL );
+         elapsed = ( end.tv_sec - start.tv_sec ) + 1e-6 * ( end.tv_usec - start.tv_usec );
+         std::cout << "Time elapsed for " << solver << " (seconds): " << elapsed << std::endl;
+         gettimeofday( &start, NULL );
+      }
+      factored = __factor__( jans::gf2solver::unfilter( nullvector, filtered ), sol_p, sol_q );
+      return factored;
+   };
+
+   std::vector<std::vector<uint32_t>> nullspace; // The block solvers find all dependencies at once
+   switch ( linalg ){
+      case LINALG_LANCZOS:
+         nullspace = jans::gf2solver::lanczos(space, basis_size);
+         break;
+      case LINALG_WIEDEMANN:
+         nullspace = jans::gf2solver::wiedemann(space, basis_size);
+         break;
+      default:
+         jans::gf2solver::structured_gaussian(space, basis_size, sink, scratch);
+   }
+   for ( const std::vector<uint32_t> & nullvector : nullspace ){
+      if ( sink( nullvector ) ){ break; }
+   }
+
+   gettimeofday( &end, NULL );
+   elapsed = ( end.tv_sec - start.tv_sec ) + 1e-6 * ( end.tv_usec - start.tv_usec );
+   if ( dependencies == 0 ){
+      std::cout << "Time elapsed for " << solver << " (seconds): " << elapsed << std::endl;
+   } else {
+      std::cout << "Time elapsed for constructing the solution from " << dependencies << " dependencies (seconds): " << elapsed << std::endl;
+   }
+   if ( factored == false ){ std::cerr << "   Error: Increase -Z, --congruences" << std::endl; }
+   return factored;
+
+}
+
+void jans::sieve::__sieve__(){
+
+   if ( pipeline[ 0 ] * pipeline[ 1 ] * pipeline[ 2 ] > 0 ){ __sieve_pipeline__(); }
+   else if ( blocksize > 0 ){ __sieve_blocks__(); }
+   else { __sieve_polynomials__(); }
+
+}
+
+bool jans::sieve::__next_polynomial__( jans::big_int & a, jans::big_int & b, jans::big_int & mpqs_q, ubase_t & poly, ubase_t & poly_end ){
+
+   // Returns false if no polynomial was found because sufficient relations were found or the range [ next_poly, last_poly ) ran out
+   // On success, the index of the polynomial is poly - 1: the caller opens it for every thread which logs its relations
+
+   while ( stop.load( std::memory_order_relaxed ) == false ){
+      if ( poly == poly_end ){
+         if ( poly_end > 0 ){ __close__( poly_end - POLY_CHUNK ); } // Its last polynomial was opened by the caller
+         poly     = __open_chunk__();
+         poly_end = poly + POLY_CHUNK;
+      }
+      if ( poly >= last_poly ){ return false; } // End of the work unit
+      __mpqs_q__( mpqs_q, poly ); // Keep p % 4 == 3  and  p * p <= sqrt(2N)/M
+      poly++;
+      if ( __check_mpqs_q__( a, b, mpqs_q ) ){ return true; } // 0 <= b < a /2
+   }
+   return false;
+
+}
+
+ubase_t jans::sieve::__open_chunk__(){
+
+   // Hands out the next POLY_CHUNK polynomial indices: the first one is open until the chunk is used up
+
+   if ( log_fd < 0 ){ return next_poly.fetch_add( POLY_CHUNK ); }
+   std::lock_guard<std::mutex> lock( open_mutex );
+   const ubase_t poly = next_poly.fetch_add( POLY_CHUNK );
+   open_polys.insert( poly );
+   return poly;
+
+}
+
+void jans::sieve::__sieve_polynomials__(){
+
+   // Each thread sieves its own polynomials over the full interval [ -M, M ]
+
    #pragma omp parallel
    {
       jans::big_int a;
@@ -81,22 +296,44 @@ void jans::sieve::run( jans::big_int & sol_p, jans::big_int & sol_q, const doubl
 
       const ubase_t size = 2 * M + 1;
       double  * sumlog = new double[ size ];
-      ubase_t * shift1 = new ubase_t[ num_primes ];
-      ubase_t * shift2 = new ubase_t[ num_primes ];
+      ubase_t * shift1 = new ubase_t[ num_primes + num_powers ];
+      ubase_t * shift2 = new ubase_t[ num_primes + num_powers ];
 
-      while ( factorization.size() < required ){
-         bool okprime = false;
-         while ( okprime == false ){
-            #pragma omp critical
-            {
-               jans::big_int::minus( shared_mpqs_q, 4 ); // Keep p % 4 == 3  and  p * p <= sqrt(2N)/M
-               private_mpqs_q.copy( shared_mpqs_q );
+      ubase_t poly     = 0; // Chunk [ poly, poly_end ) of the polynomial indices belongs to this thread
+      ubase_t poly_end = 0;
+
+      std::vector<smooth_number> buffer;
+      std::vector<survivor> batch;
+      std::vector<ubase_t> opened; // Polynomials sieved by this thread, but not closed yet
+
+      bool progress = true;
+      #ifdef _OPENMP
+      progress = ( omp_get_thread_num() == 0 );
+      #endif
+
+      while ( __next_polynomial__( a, b, private_mpqs_q, poly, poly_end ) ){
+         __open__( poly - 1 );
+         const double threshold = control.threshold( poly - 1 );
+         const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+         __calculate_shifts__( shift1, shift2, a, b );
+         if ( __sieve_sumlog__( 0, size, sumlog, shift1, shift2 ) ){
+            sieve_stats stats = {};
+            __check_sumlog__( 0, size, sumlog, shift1, threshold, a, b, poly - 1, stats, buffer, batch );
+            __flush__( buffer );
+            opened.push_back( poly - 1 );
+            __close__( opened, batch );
+            __report__( private_mpqs_q, stats, progress );
+            if ( adaptive ){ // The update takes the lock of the controller
+               const std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - begin;
+               control.update( threshold, stats.survivors, stats.smooths, seconds.count(), stats.seconds_extract );
             }
-            okprime = __check_mpqs_q__( a, b, private_mpqs_q ); // 0 <= b < a /2
          }
-         __calculate_shifts__( shift1, shift2, a, b );
-         __sieve_sumlog__( size, sumlog, shift1, shift2 );
-         __check_sumlog__( size, sumlog, shift1, threshold, a, b, private_mpqs_q );
+      }
+      if ( ( batch.empty() == false ) && ( stop.load() == false ) ){ // The polynomial range ran out
+         sieve_stats stats = {};
+         __extract_batch__( batch, shift1, stats, buffer );
+         __flush__( buffer );
+         __close__( opened, batch );
       }
 
       delete [] shift1;
@@ -104,65 +341,153 @@ void jans::sieve::run( jans::big_int & sol_p, jans::big_int & sol_q, const doubl
       delete [] sumlog;
    }
 
-   gettimeofday( &end, NULL );
-   double elapsed = ( end.tv_sec - start.tv_sec ) + 1e-6 * ( end.tv_usec - start.tv_usec );
-   std::cout << "Time elapsed for sieving (seconds): " << elapsed << std::endl;
+}
 
-    std::vector<std::vector<uint32_t>> space = __gf2sparse__(factorization);
-    std::vector<uint32_t> relevant = jans::gf2solver::space_contributions(space, 1U + num_primes);
-    //std::cout << "jans::gf2solver::space_contributions: Removed " << space.size() - relevant.size() << " of the " << space.size() << " vectors with a unique odd prime power." << std::endl;
-    factorization = __gf2prune__(factorization, relevant);
-    space = __gf2sparse__(factorization);
+void jans::sieve::__sieve_blocks__(){
 
-   gettimeofday( &start, NULL );
-   std::vector<std::vector<uint32_t>> nullspace = jans::gf2solver::gaussian(space, 1U + num_primes);
-   gettimeofday( &end, NULL );
-   elapsed = ( end.tv_sec - start.tv_sec ) + 1e-6 * ( end.tv_usec - start.tv_usec );
-   std::cout << "Time elapsed for Gaussian elimination (seconds): " << elapsed << std::endl;
-   gettimeofday( &start, NULL );
-   __factor__( nullspace, sol_p, sol_q );
-   gettimeofday( &end, NULL );
-   elapsed = ( end.tv_sec - start.tv_sec ) + 1e-6 * ( end.tv_usec - start.tv_usec );
-   std::cout << "Time elapsed for constructing the solution (seconds): " << elapsed << std::endl;
+   // All threads sieve the same polynomial: [ -M, M ] is split in blocks of blocksize, the shifts are shared
+
+   jans::big_int a;
+   jans::big_int b;
+   jans::big_int mpqs_q;
+
+   const ubase_t size       = 2 * M + 1;
+   const ubase_t num_blocks = ( size + blocksize - 1 ) / blocksize;
+   ubase_t * shift1 = new ubase_t[ num_primes + num_powers ];
+   ubase_t * shift2 = new ubase_t[ num_primes + num_powers ];
+
+   ubase_t poly     = 0;
+   ubase_t poly_end = 0;
+   bool    more     = true;
+   sieve_stats stats;
+   double  threshold = 0.0;
+   std::chrono::steady_clock::time_point begin;
+
+   #pragma omp parallel
+   {
+      double  * sumlog = new double[ blocksize ];
+      ubase_t * helper = new ubase_t[ num_primes ];
+      std::vector<smooth_number> buffer;
+      std::vector<survivor> batch;
+      std::vector<ubase_t> opened; // Polynomials with relations of this thread, but not closed yet
+
+      while ( true ){
+
+         #pragma omp single
+         {
+            more = __next_polynomial__( a, b, mpqs_q, poly, poly_end );
+            if ( more ){
+               threshold = control.threshold( poly - 1 );
+               begin     = std::chrono::steady_clock::now();
+               __calculate_shifts__( shift1, shift2, a, b );
+            }
+            stats = {};
+         }
+         if ( more == false ){ break; }
+         __open__( poly - 1 ); // By every thread, as each one logs its own relations
+
+         sieve_stats private_stats = {};
+
+         #pragma omp for schedule(dynamic)
+         for ( ubase_t block = 0; block < num_blocks; block++ ){
+            const ubase_t start  = block * blocksize;
+            const ubase_t length = ( ( start + blocksize <= size ) ? blocksize : ( size - start ) );
+            if ( __sieve_sumlog__( start, length, sumlog, shift1, shift2 ) ){
+               __check_sumlog__( start, length, sumlog, helper, threshold, a, b, poly - 1, private_stats, buffer, batch );
+            }
+         }
+         __flush__( buffer );
+         opened.push_back( poly - 1 );
+         __close__( opened, batch );
+
+         #pragma omp atomic
+         stats.checked += private_stats.checked;
+         #pragma omp atomic
+         stats.sumlog  += private_stats.sumlog;
+         #pragma omp atomic
+         stats.smooth  += private_stats.smooth;
+         #pragma omp atomic
+         stats.split   += private_stats.split;
+         for ( int bin = 0; bin < THRESHOLD_BINS; bin++ ){
+            #pragma omp atomic
+            stats.survivors[ bin ] += private_stats.survivors[ bin ];
+            #pragma omp atomic
+            stats.smooths[ bin ]   += private_stats.smooths[ bin ];
+         }
+         #pragma omp atomic
+         stats.seconds_extract += private_stats.seconds_extract;
+         #pragma omp barrier
+
+         #pragma omp master
+         {
+            __report__( mpqs_q, stats, true );
+            if ( adaptive ){
+               int num_threads = 1;
+               #ifdef _OPENMP
+               num_threads = omp_get_num_threads();
+               #endif
+               const std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - begin;
+               control.update( threshold, stats.survivors, stats.smooths, seconds.count(), stats.seconds_extract / num_threads ); // Wall time
+            }
+         }
+         #pragma omp barrier
+      }
+      if ( ( batch.empty() == false ) && ( stop.load() == false ) ){ // The polynomial range ran out
+         sieve_stats private_stats = {};
+         __extract_batch__( batch, helper, private_stats, buffer );
+         __flush__( buffer );
+         __close__( opened, batch );
+      }
+
+      delete [] helper;
+      delete [] sumlog;
+   }
+
+   delete [] shift1;
+   delete [] shift2;
 
 }
 
-std::vector<std::vector<uint32_t>> jans::__gf2sparse__(const std::vector<jans::smooth_number>& list)
+std::vector<std::vector<uint32_t>> jans::__gf2sparse__(const std::vector<jans::smooth_number>& list, const uint32_t num_primes, std::unordered_map<uint32_t, uint32_t>& large_columns)
 {
     std::vector<std::vector<uint32_t>> result;
+    std::vector<prime_factor> factors;
 
     for (const smooth_number& sn : list)
     {
+        __unpack_factors__(sn, factors);
         std::vector<uint32_t> sparse;
-        sparse.reserve(1U + sn.factors.size());
+        sparse.reserve(3U + factors.size());
         if (sn.negative)
         {
             sparse.push_back(0U);
         }
-        for (const prime_factor& pf : sn.factors)
+        for (const prime_factor& pf : factors)
         {
             if (pf.power & 1U)
             {
                 sparse.push_back(pf.index + 1U);
             }
         }
+        if (sn.large[0] != sn.large[1]) // Two equal large primes form a square
+        {
+            const size_t first_large = sparse.size();
+            for (const uint32_t large : sn.large)
+            {
+                if (large > 1U)
+                {
+                    const uint32_t column = 1U + num_primes + large_columns.size();
+                    sparse.push_back(large_columns.emplace(large, column).first->second);
+                }
+            }
+            std::sort(sparse.begin() + first_large, sparse.end());
+        }
         result.push_back(sparse);
     }
 
     return result;
 }
 
-std::vector<jans::smooth_number> jans::__gf2prune__(const std::vector<jans::smooth_number>& list, const std::vector<uint32_t>& relevant)
-{
-    std::vector<smooth_number> result;
-    result.reserve(relevant.size());
-    for (uint32_t item : relevant)
-    {
-        result.push_back(list[item]);
-    }
-    return result;
-}
-
 bool jans::sieve::__check_mpqs_q__( jans::big_int & a, jans::big_int & b, jans::big_int & mpqs_q ){
 
    // Check 1: factor base does not divide mpqs_q --> if not probably prime then
@@ -235,7 +560,7 @@ bool jans::sieve::__check_mpqs_q__( jans::big_int & a, jans::big_int & b, jans::
 void jans::sieve::__calculate_shifts__( ubase_t * shift1, ubase_t * shift2, jans::big_int & a, jans::big_int & b ){
 
    jans::big_int work;
-   for ( int ip = 0; ip < num_primes; ip++ ){
+   for ( int ip = 0; ip < num_primes + num_powers; ip++ ){
       ubase_t pri = primes[ ip ];
       ubase_t inv = __inv_x_mod_p__( a, pri );
       ubase_t rmb = jans::big_int::div( work, b, pri );
@@ -246,111 +571,121 @@ void jans::sieve::__calculate_shifts__( ubase_t * shift1, ubase_t * shift2, jans
 
 }
 
-void jans::sieve::__factor__(const std::vector<std::vector<uint32_t>>& nullspace, jans::big_int & p, jans::big_int & q)
+ubase_t jans::sieve::__first_hit__( const ubase_t shift, const ubase_t prime, const ubase_t start ){
+
+   // Smallest index >= start with index % prime == shift, relative to start
+
+   if ( shift >= start ){ return ( shift - start ); }
+   const ubase_t steps = ( start - shift + prime - 1 ) / prime;
+   return ( shift + steps * prime - start );
+
+}
+
+bool jans::sieve::__factor__(const std::vector<uint32_t>& nullvector, jans::big_int & p, jans::big_int & q)
 {
+    // Returns true if the congruence X^2 = Y^2 mod kN of the dependency nullvector splits N into p x q
+
     jans::big_int x;
     jans::big_int y;
     jans::big_int work1;
     jans::big_int work2;
     jans::big_int work3;
 
-    for (const std::vector<uint32_t>& nullvector : nullspace)
-    {
-        y.copy( 1 );
+    // The relations only store ( poly, x ): a, b and mpqs_q are recomputed for the polynomials which occur in the dependency
+    std::map<uint32_t, std::vector<jans::big_int>> polynomials; // poly --> { a, b, mpqs_q }
+    std::vector<prime_factor> factors;
+    std::vector<ubase_t> powers(num_primes, 0U);
+    std::map<uint32_t, uint32_t> large_powers; // Large prime --> power
 
-        for (ubase_t ip = 0; ip < num_primes; ++ip){
-            ubase_t pow = 0;
+    x.copy( 1 );
+    y.copy( 1 );
 
-            for (const uint32_t& item : nullvector)
-            {
-                for (const prime_factor& pf : factorization[item].factors)
-                {
-                    if (pf.index == ip){
-                        pow += pf.power; // Some are other than one --> how to retrieve from x and p ?
-                    }
-                }
-            }
-            assert( pow % 2 == 0 );
-            pow = pow / 2;
-            work2.copy( pow );
-            work1.copy( primes[ ip ] );
-            jans::big_int::power( work3, work1, work2, target ); // work3 = prime ^ ( pow ) % N
-            jans::big_int::prod( work1, y, work3 );
-            jans::big_int::div( work2, y, work1, target ); // y *= work3 % N
+    for (const uint32_t& item : nullvector)
+    {
+        const smooth_number& sn = factorization[item];
+        __unpack_factors__(sn, factors);
+        for (const prime_factor& pf : factors)
+        {
+            powers[pf.index] += pf.power;
         }
-        for (const uint32_t& item : nullvector){
-            jans::big_int::prod(work1, y, factorization[item].pval);
-            jans::big_int::div( work2, y, work1, target ); // y *= p(a,vec) % N
+        for (const uint32_t large : sn.large)
+        {
+            if (large > 1U) { large_powers[large]++; }
         }
 
-        x.copy( 1 );
-
-        for (const uint32_t& item : nullvector){
-            jans::big_int::prod(work1, x, factorization[item].xval);// xvalues[ vec ] );
-            jans::big_int::div( work2, x, work1, target );
+        std::map<uint32_t, std::vector<jans::big_int>>::iterator it = polynomials.find(sn.poly);
+        if (it == polynomials.end())
+        {
+            std::vector<jans::big_int> abq(3);
+            __polynomial__( abq[0], abq[1], abq[2], sn.poly );
+            it = polynomials.emplace(sn.poly, abq).first;
         }
 
-        jans::big_int::diff( work2, target, y ); // work2 = -y mod N = N - y
-        if ( ( jans::big_int::equal( x, y ) == false ) && ( jans::big_int::equal( x, work2 ) == false ) )
-        {
-            if ( jans::big_int::smaller( x, y ) )
-            {
-                jans::big_int::diff( work1, y, x );
-                jans::big_int::gcd( work2, work1, target );
-            } else {
-                jans::big_int::diff( work1, x, y );
-                jans::big_int::gcd( work2, work1, target );
-            }
+        // xval = abs( a * x + b ), with b < a / 2
+        const ubase_t abs_x = ( ( sn.x < 0 ) ? -sn.x : sn.x );
+        jans::big_int::prod( work1, it->second[0], abs_x );
+        if ( sn.x < 0 ){ jans::big_int::diff( work1, work1, it->second[1] ); }
+                   else { jans::big_int::sum(  work1, work1, it->second[1] ); }
+        jans::big_int::prod( work2, x, work1 );
+        jans::big_int::div( work3, x, work2, target ); // x *= xval % kN
+
+        jans::big_int::prod( work2, y, it->second[2] );
+        jans::big_int::div( work3, y, work2, target ); // y *= pval % kN
+    }
 
-            jans::big_int::div( work1, x, target, work2 );
-            assert( jans::big_int::equal( x, 0 ) ); // Remainder zero
+    for (int ip = 0; ip < num_primes; ++ip){
+        assert( powers[ip] % 2 == 0 );
+        if ( powers[ip] == 0 ){ continue; }
+        work2.copy( powers[ip] / 2 );
+        work1.copy( primes[ ip ] );
+        jans::big_int::power( work3, work1, work2, target ); // work3 = prime ^ ( pow ) % kN
+        jans::big_int::prod( work1, y, work3 );
+        jans::big_int::div( work2, y, work1, target ); // y *= work3 % kN
+    }
 
-            if ( ! ( jans::big_int::equal( work1, 1 ) || ( jans::big_int::equal( work2, 1 ) ) ) )
-            {
-                p.copy( work2 );
-                q.copy( work1 );
-                return;
-            }
-        }
+    for (const std::pair<const uint32_t, uint32_t>& lp : large_powers){
+        assert( lp.second % 2 == 0 );
+        work2.copy( lp.second / 2 );
+        work1.copy( lp.first );
+        jans::big_int::power( work3, work1, work2, target ); // work3 = large prime ^ ( pow ) % kN
+        jans::big_int::prod( work1, y, work3 );
+        jans::big_int::div( work2, y, work1, target ); // y *= work3 % kN
     }
-    std::cerr << "   Error: Increase -Z, --congruences" << std::endl;
-}
 
-inline jans::smooth_number __pack_smooth_number__(const bool negative, const jans::big_int& xval, const jans::big_int& pval, ubase_t * powers, const ubase_t num_primes)
-{
-    jans::smooth_number result;
-    result.negative = negative;
-    result.xval.copy(xval);
-    result.pval.copy(pval);
-    size_t length = 0;
-    for (ubase_t ip = 0; ip < num_primes; ++ip)
+    jans::big_int::diff( work2, target, y ); // work2 = -y mod kN = kN - y
+    if ( ( jans::big_int::equal( x, y ) == false ) && ( jans::big_int::equal( x, work2 ) == false ) )
     {
-        if (powers[ip] != 0)
+        // X^2 = Y^2 mod kN implies X^2 = Y^2 mod N: the multiplier is stripped by taking the gcd with N
+        if ( jans::big_int::smaller( x, y ) )
         {
-            ++length;
+            jans::big_int::diff( work1, y, x );
+            jans::big_int::gcd( work2, work1, number );
+        } else {
+            jans::big_int::diff( work1, x, y );
+            jans::big_int::gcd( work2, work1, number );
         }
-    }
-    result.factors.reserve(length);
-    for (ubase_t ip = 0; ip < num_primes; ++ip)
-    {
-        if (powers[ip] != 0)
+
+        jans::big_int::div( work1, x, number, work2 );
+        assert( jans::big_int::equal( x, 0 ) ); // Remainder zero
+
+        if ( ! ( jans::big_int::equal( work1, 1 ) || ( jans::big_int::equal( work2, 1 ) ) ) )
         {
-            result.factors.push_back({ip, powers[ip]});
-            //prime_factor pf;
-            //pf.index = ip;
-            //pf.power = helper[ip];
-            //result.idx_primes.push_back(ip);
-            //result.idx_powers.push_back(helper[ip]);
+            p.copy( work2 );
+            q.copy( work1 );
+            return true;
         }
     }
-    return result;
+    return false;
 }
 
-void jans::sieve::__check_sumlog__( const ubase_t size, double * sumlog, ubase_t * helper, const double threshold, jans::big_int & a, jans::big_int & b, jans::big_int & mpqs_q ){
+void jans::sieve::__check_sumlog__( const ubase_t start, const ubase_t size, double * sumlog, ubase_t * helper, const double threshold, jans::big_int & a, jans::big_int & b, const ubase_t poly, sieve_stats & stats, std::vector<smooth_number> & buffer, std::vector<survivor> & batch ){
 
    // 0 <= b < a/2
    // ( a * x + 2 * b ) * x is non-negative ( check with x in [-M, -1] and [0, M] resp. )
    // ( a * x + b ) is negative for x in [-M, -1] and non-negative for x in [0, M] resp. )
+   // sumlog[ 0 : size ] covers cnt in [ start, start + size ) with x = cnt - M
+   // Relations are appended to the thread-local buffer
+   // If batchsize > 0, the survivors are collected in the thread-local batch instead, across polynomials
 
    jans::big_int work1;
    jans::big_int work2;
@@ -360,11 +695,8 @@ void jans::sieve::__check_sumlog__( const ubase_t size, double * sumlog, ubase_t
    jans::big_int::div( abs_c, work1, work2, a );
    assert( jans::big_int::equal( work1, 0 ) );
 
-   int cnt_sumlog = 0;
-   int cnt_smooth = 0;
-
-   ubase_t cnt = 0;
-   while ( ( cnt < size ) && ( factorization.size() < required ) ){
+   ubase_t cnt = start;
+   while ( ( cnt < start + size ) && ( stop.load( std::memory_order_relaxed ) == false ) ){
 
       // work1 = a * x * x + 2 * b * x >= 0
       const ubase_t abs_x = ( ( cnt < M ) ? ( M - cnt ) : ( cnt - M ) );
@@ -379,63 +711,105 @@ void jans::sieve::__check_sumlog__( const ubase_t size, double * sumlog, ubase_t
       if ( negative ){ jans::big_int::diff( work2, abs_c, work1 ); }
                 else { jans::big_int::diff( work2, work1, abs_c ); }
 
-      const double reference = log( jans::big_int::i2f( work2 ) ) - threshold;
-      if ( sumlog[ cnt ] > reference ){
-         cnt_sumlog++;
-         const bool smooth = __extract__( work2, helper ); // Kills work2
-         if ( smooth ){
-            cnt_smooth++;
-            jans::big_int::prod( work1, a, abs_x );
-            if ( cnt < M ){ jans::big_int::diff( work1, work1, b ); }
-                     else { jans::big_int::sum(  work1, work1, b ); }
-
-            smooth_number result = __pack_smooth_number__(negative, work1, mpqs_q, helper, num_primes);
-            #pragma omp critical
-            {
-                factorization.push_back(result);
+      const double log_q = log( jans::big_int::i2f( work2 ) );
+      if ( sumlog[ cnt - start ] > log_q - threshold ){
+         const int bin = jans::threshold_controller::bin( log_q - sumlog[ cnt - start ] );
+         stats.sumlog++;
+         stats.survivors[ bin ]++;
+         if ( batchsize > 0 ){
+            batch.push_back( { work2, poly, ( int32_t ) cnt - ( int32_t ) M, negative, bin } );
+            if ( batch.size() >= batchsize ){ __extract_batch__( batch, helper, stats, buffer ); }
+         } else {
+            std::chrono::steady_clock::time_point begin;
+            if ( adaptive ){ begin = std::chrono::steady_clock::now(); } // Only the controller uses seconds_extract
+            uint32_t large[ 2 ];
+            if ( __extract__( work2, helper ) ){ // Kills work2
+               stats.smooth++;
+               stats.smooths[ bin ]++;
+               buffer.push_back( __pack_smooth_number__( negative, poly, ( int32_t ) cnt - ( int32_t ) M, helper, num_primes, NULL ) );
+               if ( found.fetch_add( 1, std::memory_order_relaxed ) + 1 >= required ){ stop = true; }
+            } else if ( __large_primes__( work2, large ) ){ // work2 is the cofactor
+               stats.split++;
+               buffer.push_back( __pack_smooth_number__( negative, poly, ( int32_t ) cnt - ( int32_t ) M, helper, num_primes, large ) );
+               partials.fetch_add( 1, std::memory_order_relaxed );
+            }
+            if ( adaptive ){
+               const std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - begin;
+               stats.seconds_extract += seconds.count();
             }
          }
       }
       cnt++;
    }
+   stats.checked += cnt - start;
+
+}
+
+void jans::sieve::__flush__( std::vector<smooth_number> & buffer ){
 
-   #pragma omp critical
+   // Moves a thread-local buffer to the shard of the calling (OpenMP) thread, and appends it to the relation log
+
+   int shard = 0;
+   #ifdef _OPENMP
+   shard = omp_get_thread_num();
+   #endif
+   __log__( buffer );
    {
-      std::cout << "For q = " << mpqs_q.write( 10 ) << ", sieving retains " << cnt_sumlog << " / " << cnt
-                                          << " and trial division retains " << cnt_smooth << " / " << cnt_sumlog << "." << std::endl;
-      #ifdef _OPENMP
-      if ( omp_get_thread_num() == 0 )
-      #endif
-      {
-         std::cout << "Obtained / required B-smooth numbers = " << factorization.size() << " / " << required << "." << std::endl;
-      }
+      std::lock_guard<std::mutex> lock( shard_locks[ shard ] );
+      for ( smooth_number & sn : buffer ){ shards[ shard ].push_back( std::move( sn ) ); }
+   }
+   buffer.clear();
+   __check_excess__();
+
+}
+
+void jans::sieve::__report__( jans::big_int & mpqs_q, const sieve_stats & stats, const bool progress ) const{
+
+   // One write per message, so that the lines of different threads do not interleave
+   if ( quiet ){ return; }
+   std::ostringstream message;
+   message << "For q = " << mpqs_q.write( 10 ) << ", sieving retains " << stats.sumlog << " / " << stats.checked
+                                    << " and trial division retains " << stats.smooth << " / " << stats.sumlog
+                                    << " ( and " << stats.split << " partial relations with large primes )." << std::endl;
+   if ( progress ){
+      message << "Obtained / required B-smooth numbers = " << found.load( std::memory_order_relaxed ) << " / " << required << "." << std::endl;
    }
+   std::cout << message.str();
+
 }
 
-void jans::sieve::__sieve_sumlog__( const ubase_t size, double * sumlog, ubase_t * shift1, ubase_t * shift2 ) const{
+bool jans::sieve::__sieve_sumlog__( const ubase_t start, const ubase_t size, double * sumlog, ubase_t * shift1, ubase_t * shift2 ) const{
+
+   // Sieves cnt in [ start, start + size ) into sumlog[ 0 : size ]
+   // Returns false if the sieving was abandoned because sufficient relations were found
 
    for ( ubase_t cnt = 0; cnt < size; cnt++ ){ sumlog[ cnt ] = 0.0; }
 
-   for ( int ip = 0; ip < num_primes; ip++ ){
+   for ( int ip = 0; ip < num_primes + num_powers; ip++ ){
+      if ( stop.load( std::memory_order_relaxed ) ){ return false; }
       const ubase_t prime = primes[ ip ];
       const double  log_p = logval[ ip ];
-            ubase_t index = shift1[ ip ];
+            ubase_t index = __first_hit__( shift1[ ip ], prime, start );
       while ( index < size ){
          sumlog[ index ] += log_p;
          index += prime;
       }
    }
 
-   for ( int ip = 1; ip < num_primes; ip++ ){ // Not for prime 2
+   for ( int ip = 1; ip < num_primes + num_powers; ip++ ){ // Not for prime 2
+      if ( stop.load( std::memory_order_relaxed ) ){ return false; }
+      if ( roots[ ip ] == 0 ){ continue; } // Not for primes dividing k
       const ubase_t prime = primes[ ip ];
       const double  log_p = logval[ ip ];
-            ubase_t index = shift2[ ip ];
+            ubase_t index = __first_hit__( shift2[ ip ], prime, start );
       while ( index < size ){
          sumlog[ index ] += log_p;
          index += prime;
       }
    }
 
+   return true;
+
 }
 
 ucarry_t jans::sieve::optimal_factorbound( jans::big_int & number ){
@@ -446,3 +820,62 @@ ucarry_t jans::sieve::optimal_factorbound( jans::big_int & number ){
 
 }
 
+ubase_t jans::sieve::optimal_multiplier( jans::big_int & number, const ubase_t factorbound ){
+
+   /*
+    *   Knuth-Schroeppel: maximize over odd square-free k the expected contribution of the small primes
+    *   to log( Q(x) ) when sieving on kN, minus the growth 0.5 * log( k ) of the sieve values:
+    *      p = 2     : 2 log( 2 ), log( 2 ) or 0.5 log( 2 ) for kN % 8 = 1, 5 or 3 & 7
+    *      p | k     :     log( p ) / p
+    *      (kN/p) = 1: 2 * log( p ) / ( p - 1 )
+    */
+
+   const ubase_t candidates[] = {  1,  3,  5,  7, 11, 13, 15, 17, 19, 21, 23, 29, 31, 33, 35, 37, 39, 41, 43,
+                                  47, 51, 53, 55, 57, 59, 61, 65, 67, 69, 71, 73, 77, 79, 83, 85, 87, 89, 91, 93, 95, 97 };
+   const int num_cand = sizeof( candidates ) / sizeof( ubase_t );
+
+   const ubase_t bound = ( ( factorbound < 2000 ) ? factorbound : 2000 );
+   jans::big_int work;
+   const ubase_t n_mod_8 = jans::big_int::div( work, number, 8 );
+
+   ubase_t best_k     = 1;
+   double  best_score = -1e100;
+
+   for ( int ik = 0; ik < num_cand; ik++ ){
+
+      const ubase_t k = candidates[ ik ];
+      bool coprime = true;
+      for ( ubase_t p = 3; p <= k; p += 2 ){
+         if ( ( k % p == 0 ) && ( jans::big_int::div( work, number, p ) == 0 ) ){ coprime = false; }
+      }
+      if ( coprime == false ){ continue; }
+
+      double score = -0.5 * log( ( double ) k );
+
+      const ubase_t kn_mod_8 = ( k * n_mod_8 ) % 8;
+      if ( kn_mod_8 == 1 ){ score += 2.0 * log( 2.0 ); }
+      else if ( kn_mod_8 == 5 ){ score += log( 2.0 ); }
+      else { score += 0.5 * log( 2.0 ); }
+
+      for ( ubase_t p = 3; p <= bound; p += 2 ){
+         bool prime = true;
+         for ( ubase_t d = 3; ( d * d <= p ) && ( prime ); d += 2 ){ prime = ( p % d != 0 ); }
+         if ( prime == false ){ continue; }
+         if ( k % p == 0 ){
+            score += log( ( double ) p ) / p;
+         } else {
+            const ubase_t kn_mod_p = ( ( ucarry_t )( k % p ) * jans::big_int::div( work, number, p ) ) % p;
+            if ( __legendre_symbol__( kn_mod_p, p ) == 1 ){ score += 2.0 * log( ( double ) p ) / ( p - 1 ); }
+         }
+      }
+
+      if ( score > best_score ){
+         best_score = score;
+         best_k     = k;
+      }
+   }
+
+   return best_k;
+
+}
+
@@ -22,7 +22,21 @@
 
 #include "big_int.h"
 #include "gf2solver/gf2solver.h"
+#include "threshold_controller.h"
 #include <vector>
+#include <set>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+#include <string>
+
+#define LINALG_GAUSSIAN 0
+#define LINALG_LANCZOS  1
+#define LINALG_WIEDEMANN 2
+
+#define FILTER_EXCESS 64 // Excess kept by the clique removal, on top of the number of congruences
+
+#define LARGE_PRIME_RATIO 64 // Partial relations keep cofactors of one or two primes up to this multiple of the factor bound
 
 namespace jans{
 
@@ -34,38 +48,125 @@ namespace jans{
 
     typedef struct
     {
-        jans::big_int xval; // Best to pull out?
-        jans::big_int pval;
-        std::vector<prime_factor> factors;
-        bool negative;
+        uint32_t poly;                // mpqs_q = mpqs_q0 - 4 * ( poly + 1 ), pval = mpqs_q
+        int32_t  x;                   // In [-M, M], xval = abs( a * x + b )
+        bool     negative;
+        std::vector<uint8_t> factors; // Varint coded: ( index delta << 1 | power > 1 ) [, power]
+        uint32_t large[ 2 ];          // Primes above the factor base of a partial relation, 1 if absent
     } smooth_number;
 
-    static std::vector<std::vector<uint32_t>> __gf2sparse__(const std::vector<smooth_number>& list);
+    typedef struct
+    {
+        jans::big_int value; // abs( Q(x) ), retained by the sieve
+        uint32_t poly;
+        int32_t  x;
+        bool     negative;
+        int      bin; // Deficit bin
+    } survivor;
+
+    typedef struct
+    {
+        int checked; // x values examined
+        int sumlog;  // x values retained by the sieve
+        int smooth;  // x values retained by trial division
+        int split;   // x values kept as partial relations, with one or two large primes
+        int survivors[ THRESHOLD_BINS ]; // x values retained by the sieve, by deficit bin
+        int smooths[ THRESHOLD_BINS ];   // x values retained by trial division, by deficit bin
+        double seconds_extract;          // Spent on the x values retained by the sieve
+    } sieve_stats;
+
+    // Large primes get the basis indices from 1 + num_primes onwards, in order of first occurrence in large_columns
+    std::vector<std::vector<uint32_t>> __gf2sparse__(const std::vector<smooth_number>& list, const uint32_t num_primes, std::unordered_map<uint32_t, uint32_t>& large_columns);
+
+    smooth_number __pack_smooth_number__(const bool negative, const uint32_t poly, const int32_t x, ubase_t * powers, const ubase_t num_primes, const uint32_t * large);
+
+    inline bool __is_partial__(const smooth_number& sn){ return (sn.large[0] > 1U); }
+
+    void __unpack_factors__(const smooth_number& sn, std::vector<prime_factor>& factors);
 
-    static std::vector<smooth_number> __gf2prune__(const std::vector<smooth_number>& list, const std::vector<uint32_t>& relevant);
+    // Relations with the same key are duplicates
+    inline uint64_t __relation_key__(const smooth_number& sn){ return ((uint64_t)(sn.poly) << 32) | (uint32_t)(sn.x); }
+
+    void __serialize_relations__(std::vector<uint8_t>& out, const std::vector<smooth_number>& list);
+
+    bool __deserialize_relations__(const uint8_t * data, const size_t size, const uint32_t count, std::vector<smooth_number>& list);
 
    class sieve{
 
       public:
 
-         sieve( jans::big_int & num, const ubase_t factorbound, const ubase_t sievespace, const int extra );
+         sieve( jans::big_int & num, const ubase_t multiplier, const ubase_t factorbound, const ubase_t sievespace, const int extra );
 
          virtual ~sieve();
 
          static ucarry_t optimal_factorbound( jans::big_int & number );
 
-         void run( jans::big_int & sol_p, jans::big_int & sol_q, const double threshold );
+         static ubase_t optimal_multiplier( jans::big_int & number, const ubase_t factorbound );
+
+         static void autotune( jans::big_int & number, ubase_t & factorbound, ubase_t & sievespace, double & threshold, const std::string & calibration );
+
+         double trial( const double threshold, const ubase_t polys );
+
+         void set_blocksize( const ubase_t blocksize );
+
+         void set_pipeline( const int generators, const int sievers, const int checkers );
+
+         void set_batchsize( const ubase_t batchsize );
+
+         bool set_logfile( const std::string & filename, const bool resume );
+
+         void set_verify( const bool verify );
+
+         void set_adaptive( const bool adaptive );
+
+         void set_linalg( const int linalg );
+
+         bool set_scratch( const std::string & directory );
+
+         bool set_coordinator( const int port );
+
+         bool work( const std::string & host, const int port, const double threshold );
+
+         bool run( jans::big_int & sol_p, jans::big_int & sol_q, const double threshold );
 
       private:
 
          ubase_t M;
 
-         jans::big_int target; // N
+         // Sieving mode
+
+         ubase_t blocksize; // > 0: all threads sieve one polynomial in blocks
+
+         int pipeline[ 3 ]; // > 0: threads for polynomial generation, sieving and checking
+
+         ubase_t batchsize; // > 0: survivors of the sieve are tested for smoothness in batches of this size
+
+         std::vector<ubase_t> fb_product; // Product of the factor base primes (long number) for the batches
+
+         bool verify; // Recompute Q(x) of every relation from its factors before the linear algebra
+
+         bool quiet; // No progress messages ( trial runs of the autotuner )
+
+         bool adaptive; // Adapt the threshold T online
+
+         int linalg; // LINALG_GAUSSIAN, LINALG_LANCZOS or LINALG_WIEDEMANN
+
+         std::string scratch; // Non-empty: directory for the out-of-core dense matrix of LINALG_GAUSSIAN
+
+         jans::threshold_controller control; // Threshold T per polynomial
+
+         jans::big_int number; // N
+
+         ubase_t multiplier; // k
+
+         jans::big_int target; // k * N
 
          // Factor base information
 
          int num_primes;
 
+         int num_powers; // Prime powers p^e <= factorbound, stored after the primes: primes[ num_primes + i ] = p^e
+
          ubase_t * primes;
 
          ubase_t * roots;
@@ -80,6 +181,8 @@ namespace jans{
 
          int required; // powspace + extra_sz
 
+         ubase_t large_bound; // Largest prime of the partial relations: LARGE_PRIME_RATIO * F, below 2^BLOCK_BIT
+
          //int lincount;
 
          //jans::big_int * xvalues;
@@ -90,6 +193,50 @@ namespace jans{
 
          std::vector<smooth_number> factorization;
 
+         int num_shards; // One relation list per thread: only its owner appends to it during sieving
+
+         std::vector<smooth_number> * shards;
+
+         std::mutex * shard_locks; // Guard the shards against the filter while sieving
+
+         std::atomic<int> found; // Total number of full relations in the shards
+
+         std::atomic<int> partials; // Total number of partial relations in the shards
+
+         // Filtered excess: sieving stops once the relations exceed their active primes by extra after singleton removal
+
+         std::atomic<int> next_filter; // Value of found + partials at which the relations are filtered again
+
+         std::mutex filter_mutex;
+
+         // Polynomial dispenser: polynomial index poly has mpqs_q = mpqs_q0 - 4 * ( poly + 1 )
+
+         jans::big_int mpqs_q0;
+
+         std::atomic<ubase_t> next_poly; // First index not yet handed out to a thread
+
+         std::atomic<bool> stop; // Set when sufficient relations are found: threads abandon in-flight work
+
+         ubase_t first_poly; // Polynomial index at which sieving starts ( > 0 when resumed from the relation log )
+
+         ubase_t last_poly; // Polynomial indices >= last_poly are not handed out ( end of a work unit )
+
+         // Distributed sieving
+
+         int listener; // >= 0: hand out work units to the workers which connect to this socket instead of sieving
+
+         // Relation log
+
+         int log_fd; // -1 if there is no relation log
+
+         std::mutex log_mutex;
+
+         double log_synced; // Time of the last fsync
+
+         std::multiset<ubase_t> open_polys; // Polynomial indices whose relations are not all logged yet, once per thread which logs them
+
+         std::mutex open_mutex; // Guards open_polys, and next_poly against __checkpoint__
+
          // Helper funcionality
 
          static int __legendre_symbol__( jans::big_int & num, jans::big_int & p );
@@ -102,27 +249,83 @@ namespace jans{
 
          static ubase_t __inv_x_mod_p__( jans::big_int & x, const ubase_t p );
 
+         static ubase_t __inv_x_mod_p__( const ubase_t x, const ubase_t p );
+
+         static ubase_t __hensel_lift__( const ubase_t root, jans::big_int & num, const ubase_t p, const ubase_t pe );
+
          static ubase_t __root_quadratic_residue__( jans::big_int & num, const ubase_t p );
 
          static ubase_t __root_quadratic_residue__( const ubase_t num, const ubase_t p );
 
          bool __extract__( big_int & x, ubase_t * powers ) const;
 
+         bool __large_primes__( big_int & x, uint32_t * large ) const;
+
+         void __extract_batch__( std::vector<survivor> & batch, ubase_t * helper, sieve_stats & stats, std::vector<smooth_number> & buffer );
+
          // The core routines, in order
 
          void __startup1__( jans::big_int & mpqs_q );
 
          void __startup2__( const ubase_t bound );
 
+         void __mpqs_q__( jans::big_int & mpqs_q, const ubase_t poly );
+
+         void __polynomial__( jans::big_int & a, jans::big_int & b, jans::big_int & mpqs_q, const ubase_t poly );
+
+         void __collect_relations__();
+
+         int __excess__();
+
+         void __check_excess__();
+
+         bool __verify_relation__( const smooth_number & sn, jans::big_int & a, jans::big_int & b );
+
          bool __check_mpqs_q__( jans::big_int & a, jans::big_int & b, jans::big_int & mpqs_q );
 
+         bool __next_polynomial__( jans::big_int & a, jans::big_int & b, jans::big_int & mpqs_q, ubase_t & poly, ubase_t & poly_end );
+
          void __calculate_shifts__( ubase_t * shift1, ubase_t * shift2, jans::big_int & a, jans::big_int & b );
 
-         void __sieve_sumlog__( const ubase_t size, double * sumlog, ubase_t * shift1, ubase_t * shift2 ) const;
+         static ubase_t __first_hit__( const ubase_t shift, const ubase_t prime, const ubase_t start );
+
+         bool __sieve_sumlog__( const ubase_t start, const ubase_t size, double * sumlog, ubase_t * shift1, ubase_t * shift2 ) const;
+
+         void __check_sumlog__( const ubase_t start, const ubase_t size, double * sumlog, ubase_t * helper, const double threshold, jans::big_int & a, jans::big_int & b, const ubase_t poly, sieve_stats & stats, std::vector<smooth_number> & buffer, std::vector<survivor> & batch );
+
+         void __report__( jans::big_int & mpqs_q, const sieve_stats & stats, const bool progress ) const;
+
+         void __flush__( std::vector<smooth_number> & buffer );
+
+         void __log_header__( std::vector<uint8_t> & header );
+
+         size_t __load_log__( const uint8_t * data, const size_t size );
+
+         void __log__( const std::vector<smooth_number> & relations );
+
+         ubase_t __open_chunk__();
+
+         void __open__( const ubase_t poly );
+
+         void __close__( const ubase_t poly );
+
+         void __close__( std::vector<ubase_t> & opened, const std::vector<survivor> & batch );
+
+         ubase_t __checkpoint__();
+
+         void __sync_log__();
+
+         void __sieve__();
+
+         void __sieve_polynomials__();
+
+         void __sieve_blocks__();
+
+         void __sieve_pipeline__();
 
-         void __check_sumlog__( const ubase_t size, double * sumlog, ubase_t * helper, const double threshold, jans::big_int & a, jans::big_int & b, jans::big_int & mpsqs_q );
+         void __coordinate__();
 
-         void __factor__(const std::vector<std::vector<uint32_t>>& nullspace, jans::big_int & p, jans::big_int & q);
+         bool __factor__(const std::vector<uint32_t>& nullvector, jans::big_int & p, jans::big_int & q);
 
    };
 
@@ -0,0 +1,186 @@
+/*
+   JANS: just another number sieve
+   Copyright (C) 2018 Sebastian Wouters
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+#include <assert.h>
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "sieve.h"
+
+#define TRIAL_POLYS 256 // Polynomial indices per candidate ( F, M, T ): only a few percent yield a valid mpqs_q
+
+/*
+    Starting points by number of decimal digits of N, from the examples in the README,
+    interpolated linearly in digits for log( F ), log( M ) and T
+*/
+
+namespace{
+
+   const double table_digits[] = {      23,      29,      40,       57,        82,       100 };
+   const double table_F[]      = {    1350,    3652,   25499,   295292,   1240000,   4444444 };
+   const double table_M[]      = {   10000,   10000,   40000,   300000,   1240000,   4444444 };
+   const double table_T[]      = {     8.0,     8.0,     8.0,      8.0,      12.0,      15.0 };
+   const int    table_size     = sizeof( table_digits ) / sizeof( double );
+
+   double __interpolate__( const double * values, const double digits, const bool logarithmic ){
+
+      int i = 0;
+      while ( ( i < table_size - 2 ) && ( digits > table_digits[ i + 1 ] ) ){ i++; }
+      double alpha = ( digits - table_digits[ i ] ) / ( table_digits[ i + 1 ] - table_digits[ i ] );
+      alpha = ( ( alpha < 0.0 ) ? 0.0 : ( ( alpha > 1.0 ) ? 1.0 : alpha ) );
+      if ( logarithmic ){ return exp( ( 1.0 - alpha ) * log( values[ i ] ) + alpha * log( values[ i + 1 ] ) ); }
+      return ( ( 1.0 - alpha ) * values[ i ] + alpha * values[ i + 1 ] );
+
+   }
+
+}
+
+double jans::sieve::trial( const double threshold, const ubase_t polys ){
+
+   // Sieves the first polys polynomials and returns the estimated time to find the required relations (seconds)
+
+   __startup1__( mpqs_q0 );
+   next_poly   = 0;
+   last_poly   = polys;
+   next_filter = INT_MAX;
+   stop        = false;
+   quiet       = true;
+   control.reset( threshold, false );
+
+   struct timeval start, end;
+   gettimeofday( &start, NULL );
+   __sieve__();
+   gettimeofday( &end, NULL );
+   const double elapsed = ( end.tv_sec - start.tv_sec ) + 1e-6 * ( end.tv_usec - start.tv_usec );
+
+   const int relations = found;
+   for ( int shard = 0; shard < num_shards; shard++ ){ std::vector<smooth_number>().swap( shards[ shard ] ); }
+   found     = 0;
+   partials  = 0;
+   last_poly = __11111111__;
+   quiet     = false;
+
+   if ( relations == 0 ){ return HUGE_VAL; }
+   return ( elapsed * required / relations );
+
+}
+
+void jans::sieve::autotune( jans::big_int & number, ubase_t & factorbound, ubase_t & sievespace, double & threshold, const std::string & calibration ){
+
+   /*
+    *   Chooses the parameters which are zero ( factorbound, sievespace ) or negative ( threshold ):
+    *      1. from the calibration file, if it contains a run with at most 2 digits difference
+    *      2. otherwise by coordinate search around the table value: each candidate sieves TRIAL_POLYS polynomials,
+    *         and the one with the smallest estimated sieving time wins; the result is appended to the calibration file
+    */
+
+   const bool tune_F = ( factorbound == 0 );
+   const bool tune_M = ( sievespace  == 0 );
+   const bool tune_T = ( threshold   <  0.0 );
+   const int  digits = number.write( 10 ).length();
+
+   if ( calibration.length() > 0 ){
+      std::ifstream file( calibration.c_str() );
+      std::string line;
+      int    best_diff = 3;
+      double best[ 3 ] = { 0, 0, 0 };
+      while ( std::getline( file, line ) ){
+         if ( ( line.length() == 0 ) || ( line[ 0 ] == '#' ) ){ continue; }
+         std::istringstream fields( line );
+         int d;
+         double values[ 3 ];
+         if ( fields >> d >> values[ 0 ] >> values[ 1 ] >> values[ 2 ] ){
+            if ( abs( d - digits ) < best_diff ){
+               best_diff = abs( d - digits );
+               for ( int i = 0; i < 3; i++ ){ best[ i ] = values[ i ]; }
+            }
+         }
+      }
+      if ( best_diff < 3 ){
+         if ( tune_F ){ factorbound = best[ 0 ]; }
+         if ( tune_M ){ sievespace  = ( ( best[ 1 ] < factorbound ) ? factorbound : best[ 1 ] ); }
+         if ( tune_T ){ threshold   = best[ 2 ]; }
+         std::cout << "Autotune: parameters from " << calibration << "." << std::endl;
+         return;
+      }
+   }
+
+   if ( tune_F ){ factorbound = __interpolate__( table_F, digits, true ); }
+   if ( tune_M ){ sievespace  = __interpolate__( table_M, digits, true ); }
+   if ( tune_T ){ threshold   = __interpolate__( table_T, digits, false ); }
+   if ( sievespace < factorbound ){ sievespace = factorbound; }
+
+   ubase_t best_F = factorbound;
+   ubase_t best_M = sievespace;
+   double  best_T = threshold;
+   double  best_time = HUGE_VAL;
+
+   ubase_t base_F = best_F; // Values around which the current coordinate is varied
+   ubase_t base_M = best_M;
+   double  base_T = best_T;
+
+   const int num_cand = 7;
+   for ( int cand = 0; cand < num_cand; cand++ ){
+
+      // Candidate 0: the start; 1 & 2: vary F; 3 & 4: vary M; 5 & 6: vary T
+      if ( ( cand == 1 ) || ( cand == 3 ) || ( cand == 5 ) ){
+         base_F = best_F;
+         base_M = best_M;
+         base_T = best_T;
+      }
+      ubase_t F = base_F;
+      ubase_t M = base_M;
+      double  T = base_T;
+      if ( ( cand == 1 ) || ( cand == 2 ) ){ if ( tune_F == false ){ continue; } F = base_F * ( ( cand == 1 ) ? 0.6 : 1.6 ); }
+      if ( ( cand == 3 ) || ( cand == 4 ) ){ if ( tune_M == false ){ continue; } M = base_M * ( ( cand == 3 ) ? 0.5 : 2.0 ); }
+      if ( ( cand == 5 ) || ( cand == 6 ) ){ if ( tune_T == false ){ continue; } T = base_T + ( ( cand == 5 ) ? -2.0 : 2.0 ); }
+      if ( M < F ){
+         if ( tune_M == false ){ continue; }
+         M = F;
+      }
+      if ( ( cand > 0 ) && ( F == best_F ) && ( M == best_M ) && ( T == best_T ) ){ continue; } // Already evaluated
+
+      jans::sieve candidate( number, optimal_multiplier( number, F ), F, M, 1 );
+      const double time = candidate.trial( T, TRIAL_POLYS );
+      std::cout << "Autotune: -F " << F << " -M " << M << " -T " << T << " has estimated sieving time (seconds) " << time << std::endl;
+      if ( time < best_time ){
+         best_time = time;
+         best_F    = F;
+         best_M    = M;
+         best_T    = T;
+      }
+   }
+
+   factorbound = best_F;
+   sievespace  = best_M;
+   threshold   = best_T;
+
+   if ( calibration.length() > 0 ){
+      std::ofstream file( calibration.c_str(), std::ios::app );
+      file << digits << " " << factorbound << " " << sievespace << " " << threshold << " # estimated sieving time (seconds) " << best_time << std::endl;
+   }
+
+}
@@ -0,0 +1,132 @@
+/*
+   JANS: just another number sieve
+   Copyright (C) 2018 Sebastian Wouters
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+#include <assert.h>
+#include <chrono>
+#include <vector>
+
+#include "sieve.h"
+
+/*
+    Batch smoothness test (Bernstein, "How to find smooth parts of integers"):
+    the survivors x_i of the sieve are multiplied in a product tree, the product P of the factor base primes
+    is reduced modulo its root, and the remainder tree yields P mod x_i for every survivor at once.
+    With 2^k at least the number of bits of x_i, x_i is smooth iff ( P mod x_i )^( 2^k ) mod x_i == 0.
+*/
+
+void jans::sieve::set_batchsize( const ubase_t batchsize ){
+
+   this->batchsize = batchsize;
+   fb_product.clear();
+   if ( batchsize == 0 ){ return; }
+
+   // Product tree of the factor base primes, level by level
+   std::vector<std::vector<ubase_t>> level( num_primes );
+   for ( int ip = 0; ip < num_primes; ip++ ){ level[ ip ].assign( 1, primes[ ip ] ); }
+   while ( level.size() > 1 ){
+      std::vector<std::vector<ubase_t>> next( ( level.size() + 1 ) / 2 );
+      for ( size_t i = 0; i < next.size(); i++ ){
+         if ( 2 * i + 1 < level.size() ){ jans::big_int::long_prod( next[ i ], level[ 2 * i ], level[ 2 * i + 1 ] ); }
+                                    else { next[ i ].swap( level[ 2 * i ] ); }
+      }
+      level.swap( next );
+   }
+   fb_product.swap( level[ 0 ] );
+
+}
+
+void jans::sieve::__extract_batch__( std::vector<survivor> & batch, ubase_t * helper, sieve_stats & stats, std::vector<smooth_number> & buffer ){
+
+   // Tests all survivors in batch for smoothness, appends the relations to buffer and empties batch
+   // Once stop is set, the remaining survivors are abandoned, as in __check_sumlog__
+
+   const size_t num = batch.size();
+   if ( num == 0 ){ return; }
+   if ( stop.load( std::memory_order_relaxed ) ){
+      batch.clear();
+      return;
+   }
+   const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+
+   // tree[ 0 ] contains the survivors, tree[ l + 1 ][ i ] = tree[ l ][ 2i ] * tree[ l ][ 2i + 1 ]
+   std::vector<std::vector<std::vector<ubase_t>>> tree( 1 );
+   tree[ 0 ].resize( num );
+   for ( size_t i = 0; i < num; i++ ){ jans::big_int::to_long( tree[ 0 ][ i ], batch[ i ].value ); }
+   while ( tree.back().size() > 1 ){
+      const std::vector<std::vector<ubase_t>> & prev = tree.back();
+      std::vector<std::vector<ubase_t>> next( ( prev.size() + 1 ) / 2 );
+      for ( size_t i = 0; i < next.size(); i++ ){
+         if ( 2 * i + 1 < prev.size() ){ jans::big_int::long_prod( next[ i ], prev[ 2 * i ], prev[ 2 * i + 1 ] ); }
+                                   else { next[ i ] = prev[ 2 * i ]; }
+      }
+      tree.push_back( std::move( next ) );
+   }
+
+   // Remainder tree: rem[ i ] = P mod tree[ l ][ i ], from the root down to the survivors
+   std::vector<std::vector<ubase_t>> rem( 1 );
+   jans::big_int::long_mod( rem[ 0 ], fb_product, tree.back()[ 0 ] );
+   for ( int l = tree.size() - 2; l >= 0; l-- ){
+      std::vector<std::vector<ubase_t>> next( tree[ l ].size() );
+      for ( size_t i = 0; i < next.size(); i++ ){ jans::big_int::long_mod( next[ i ], rem[ i / 2 ], tree[ l ][ i ] ); }
+      rem.swap( next );
+   }
+
+   jans::big_int y;
+   jans::big_int work1;
+   jans::big_int work2;
+
+   for ( size_t i = 0; ( i < num ) && ( stop.load( std::memory_order_relaxed ) == false ); i++ ){
+
+      survivor & sv = batch[ i ];
+
+      // y = ( P mod x )^( 2^k ) mod x with 2^k >= number of bits of x
+      jans::big_int::from_long( y, rem[ i ] );
+      const int bits = tree[ 0 ][ i ].size() * BLOCK_BIT;
+      for ( int pow = 1; ( pow < bits ) && ( jans::big_int::equal( y, 0 ) == false ); pow *= 2 ){
+         jans::big_int::prod( work1, y, y );
+         jans::big_int::div( work2, y, work1, sv.value );
+      }
+
+      if ( jans::big_int::equal( y, 0 ) ){
+         const bool smooth = __extract__( sv.value, helper ); // Trial division only for the smooth survivors
+         assert( smooth );
+         stats.smooth++;
+         stats.smooths[ sv.bin ]++;
+         buffer.push_back( __pack_smooth_number__( sv.negative, sv.poly, sv.x, helper, num_primes, NULL ) );
+         if ( found.fetch_add( 1, std::memory_order_relaxed ) + 1 >= required ){ stop = true; }
+      } else {
+         // Cofactor = x / gcd( x, y ): the part of x without factor base primes
+         uint32_t large[ 2 ];
+         jans::big_int::gcd( work1, sv.value, y );
+         jans::big_int::div( work2, y, sv.value, work1 );
+         if ( __large_primes__( work2, large ) ){
+            __extract__( sv.value, helper ); // Trial division only for the partial relations
+            stats.split++;
+            buffer.push_back( __pack_smooth_number__( sv.negative, sv.poly, sv.x, helper, num_primes, large ) );
+            partials.fetch_add( 1, std::memory_order_relaxed );
+         }
+      }
+   }
+
+   batch.clear();
+   const std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - begin;
+   stats.seconds_extract += seconds.count();
+
+}
@@ -0,0 +1,276 @@
+/*
+   JANS: just another number sieve
+   Copyright (C) 2018 Sebastian Wouters
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+#include <assert.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <string.h>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+#include "sieve.h"
+
+/*
+    Binary relation log (-R, --relations):
+
+       header : "JANSLOG1", uint32 num_primes, uint32 M, uint32 multiplier, uint32 hash of N
+       records: uint32 LOG_RECORD, uint32 checkpoint, uint32 count, uint32 size, size bytes of relations, uint32 checksum
+
+    Each record holds the relations of one flush, serialized with __serialize_relations__, and the
+    polynomial index checkpoint = __checkpoint__() at the time of writing: the relations of all polynomials
+    below checkpoint are in the log, those from checkpoint onwards are still to be sieved. A polynomial is
+    open from the moment it is handed out until its relations are logged, also when its survivors wait in
+    a batch or it belongs to the work unit of a worker. Records are only appended, so that a crash leaves
+    at most one incomplete record at the end. It fails the checksum on loading and is truncated.
+*/
+
+#define LOG_RECORD       0x4A524543U // "JREC"
+#define LOG_HEADER       24
+#define LOG_SYNC_SECONDS 10.0        // Time between two fsync calls
+
+namespace{
+
+   uint32_t __fnv1a__( const uint8_t * data, const size_t size, uint32_t hash = 2166136261U ){
+
+      for ( size_t i = 0; i < size; i++ ){ hash = ( hash ^ data[ i ] ) * 16777619U; }
+      return hash;
+
+   }
+
+   double __now__(){
+
+      struct timeval time;
+      gettimeofday( &time, NULL );
+      return ( time.tv_sec + 1e-6 * time.tv_usec );
+
+   }
+
+   bool __write_all__( const int fd, const uint8_t * data, size_t size ){
+
+      while ( size > 0 ){
+         const ssize_t written = write( fd, data, size );
+         if ( written < 0 ){ return false; }
+         data += written;
+         size -= written;
+      }
+      return true;
+
+   }
+
+   void __put_uint32__( std::vector<uint8_t> & out, const uint32_t value ){
+
+      const uint8_t * bytes = ( const uint8_t * )( &value );
+      out.insert( out.end(), bytes, bytes + 4 );
+
+   }
+
+   uint32_t __get_uint32__( const uint8_t * data ){
+
+      uint32_t value;
+      memcpy( &value, data, 4 );
+      return value;
+
+   }
+
+}
+
+void jans::sieve::__log_header__( std::vector<uint8_t> & header ){
+
+   const std::string decimal = number.write( 10 );
+   header.assign( { 'J', 'A', 'N', 'S', 'L', 'O', 'G', '1' } );
+   __put_uint32__( header, num_primes );
+   __put_uint32__( header, M );
+   __put_uint32__( header, multiplier );
+   __put_uint32__( header, __fnv1a__( ( const uint8_t * )( decimal.data() ), decimal.size() ) );
+   assert( header.size() == LOG_HEADER );
+
+}
+
+bool jans::sieve::set_logfile( const std::string & filename, const bool resume ){
+
+   // Returns false if the file cannot be used: not writeable, or resuming a log of another run
+
+   std::vector<uint8_t> header;
+   __log_header__( header );
+
+   size_t valid = 0; // Length of the intact part of the existing log
+   if ( resume ){
+      const int fd = open( filename.c_str(), O_RDONLY );
+      if ( fd >= 0 ){
+         struct stat info;
+         const size_t size = ( ( fstat( fd, &info ) == 0 ) ? info.st_size : 0 );
+         const uint8_t * data = NULL;
+         if ( size >= LOG_HEADER ){
+            void * map = mmap( NULL, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+            if ( map != MAP_FAILED ){ data = ( const uint8_t * )( map ); }
+         }
+         close( fd );
+         if ( data == NULL ){
+            std::cerr << "   Error: cannot map the relation log " << filename << std::endl;
+            return false;
+         }
+         if ( memcmp( data, header.data(), LOG_HEADER ) != 0 ){
+            munmap( ( void * )( data ), size );
+            std::cerr << "   Error: the relation log " << filename << " belongs to another N, -K, -F or -M" << std::endl;
+            return false;
+         }
+         valid = __load_log__( data, size );
+         munmap( ( void * )( data ), size );
+         std::cout << "Resumed " << found.load() << " full and " << partials.load() << " partial relations from " << filename << ", continuing at polynomial " << first_poly << "." << std::endl;
+      }
+   }
+
+   if ( valid > 0 ){
+      log_fd = open( filename.c_str(), O_WRONLY );
+      if ( ( log_fd >= 0 ) && ( ( ftruncate( log_fd, valid ) != 0 ) || ( lseek( log_fd, 0, SEEK_END ) < 0 ) ) ){
+         close( log_fd );
+         log_fd = -1;
+      }
+   } else {
+      log_fd = open( filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+      if ( ( log_fd >= 0 ) && ( __write_all__( log_fd, header.data(), header.size() ) == false ) ){
+         close( log_fd );
+         log_fd = -1;
+      }
+   }
+   if ( log_fd < 0 ){
+      std::cerr << "   Error: cannot write the relation log " << filename << std::endl;
+      return false;
+   }
+   log_synced = __now__();
+   return true;
+
+}
+
+size_t jans::sieve::__load_log__( const uint8_t * data, const size_t size ){
+
+   // Appends the relations of all intact records to shard 0 and returns the length of the intact part
+
+   size_t pos = LOG_HEADER;
+   while ( pos + 20 <= size ){
+      const uint32_t tag        = __get_uint32__( data + pos );
+      const uint32_t checkpoint = __get_uint32__( data + pos + 4 );
+      const uint32_t count      = __get_uint32__( data + pos + 8 );
+      const uint32_t length     = __get_uint32__( data + pos + 12 );
+      if ( ( tag != LOG_RECORD ) || ( length > size - pos - 20 ) ){ break; }
+      const uint32_t checksum = __get_uint32__( data + pos + 16 + length );
+      if ( checksum != __fnv1a__( data + pos, 16 + length ) ){ break; }
+      const size_t before = shards[ 0 ].size();
+      if ( __deserialize_relations__( data + pos + 16, length, count, shards[ 0 ] ) == false ){
+         shards[ 0 ].resize( before );
+         break;
+      }
+      const int num_partial = std::count_if( shards[ 0 ].begin() + before, shards[ 0 ].end(), __is_partial__ );
+      found    += count - num_partial;
+      partials += num_partial;
+      if ( checkpoint > first_poly ){ first_poly = checkpoint; }
+      pos += 20 + length;
+   }
+   return pos;
+
+}
+
+void jans::sieve::__log__( const std::vector<smooth_number> & relations ){
+
+   // Appends one record to the relation log, if any; thread safe
+
+   if ( ( log_fd < 0 ) || ( relations.empty() ) ){ return; }
+
+   std::vector<uint8_t> record;
+   __put_uint32__( record, LOG_RECORD );
+   __put_uint32__( record, __checkpoint__() );
+   __put_uint32__( record, relations.size() );
+   __put_uint32__( record, 0 ); // Size, filled in below
+   __serialize_relations__( record, relations );
+   const uint32_t length = record.size() - 16;
+   memcpy( record.data() + 12, &length, 4 );
+   __put_uint32__( record, __fnv1a__( record.data(), record.size() ) );
+
+   std::lock_guard<std::mutex> lock( log_mutex );
+   if ( __write_all__( log_fd, record.data(), record.size() ) == false ){
+      std::cerr << "   Error: writing the relation log failed, it is closed" << std::endl;
+      close( log_fd );
+      log_fd = -1;
+      return;
+   }
+   if ( __now__() - log_synced > LOG_SYNC_SECONDS ){
+      fsync( log_fd );
+      log_synced = __now__();
+   }
+
+}
+
+void jans::sieve::__sync_log__(){
+
+   std::lock_guard<std::mutex> lock( log_mutex );
+   if ( log_fd >= 0 ){
+      fsync( log_fd );
+      log_synced = __now__();
+   }
+
+}
+
+void jans::sieve::__open__( const ubase_t poly ){
+
+   if ( log_fd < 0 ){ return; }
+   std::lock_guard<std::mutex> lock( open_mutex );
+   open_polys.insert( poly );
+
+}
+
+void jans::sieve::__close__( const ubase_t poly ){
+
+   if ( log_fd < 0 ){ return; }
+   std::lock_guard<std::mutex> lock( open_mutex );
+   std::multiset<ubase_t>::iterator it = open_polys.find( poly );
+   if ( it != open_polys.end() ){ open_polys.erase( it ); }
+
+}
+
+void jans::sieve::__close__( std::vector<ubase_t> & opened, const std::vector<survivor> & batch ){
+
+   // Closes the polynomials in opened, which were sieved and flushed by this thread, unless they still have survivors in batch
+   // After stop, survivors may have been abandoned: the polynomials stay open
+
+   if ( stop.load() ){ return; }
+   ubase_t pending = __11111111__;
+   for ( const survivor & sv : batch ){ pending = std::min( pending, ( ubase_t )( sv.poly ) ); }
+   size_t kept = 0;
+   for ( const ubase_t poly : opened ){
+      if ( poly < pending ){ __close__( poly ); }
+                      else { opened[ kept++ ] = poly; }
+   }
+   opened.resize( kept );
+
+}
+
+ubase_t jans::sieve::__checkpoint__(){
+
+   // Lowest polynomial index which is not complete: handed out, but its relations are not all logged yet
+
+   std::lock_guard<std::mutex> lock( open_mutex );
+   const ubase_t head = next_poly.load();
+   return ( ( open_polys.empty() ) ? head : std::min( head, *open_polys.begin() ) );
+
+}
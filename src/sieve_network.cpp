@@ -0,0 +1,315 @@
+/*
+   JANS: just another number sieve
+   Copyright (C) 2018 Sebastian Wouters
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+#include <assert.h>
+#include <limits.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <string.h>
+#include <algorithm>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "sieve.h"
+
+/*
+    Distributed sieving over TCP: one coordinator (-C) hands out work units, i.e. ranges of polynomial indices,
+    to workers (-W), which sieve them and send the relations back. Messages are a 16 byte header
+    { uint32 type, uint32 arg1, uint32 arg2, uint32 size } followed by size bytes of payload:
+
+       worker      --> coordinator: MSG_HELLO     payload = relation log header ( N, k, factor base size, M )
+       worker      --> coordinator: MSG_REQUEST
+       coordinator --> worker     : MSG_WORK      arg1 = first polynomial index, arg2 = number of polynomials
+       worker      --> coordinator: MSG_RELATIONS arg1 = number of relations, payload = __serialize_relations__
+       coordinator --> worker     : MSG_STOP      arg1 = 0: sufficient relations, arg1 = 1: another N, k, F or M
+
+    The coordinator drops duplicate ( poly, x ) relations, and hands out the unit of a worker which disconnects
+    before returning its relations again. A message with more than MAX_PAYLOAD bytes of payload ends the connection.
+*/
+
+#define MSG_HELLO     1
+#define MSG_REQUEST   2
+#define MSG_WORK      3
+#define MSG_RELATIONS 4
+#define MSG_STOP      5
+
+#define WORK_UNIT 64 // Polynomial indices per work unit
+#define MAX_PAYLOAD ( 1U << 24 ) // Bytes: far above the relations of one work unit, so a larger size is a corrupt or hostile peer
+
+namespace{
+
+   typedef struct
+   {
+      uint32_t type;
+      uint32_t arg1;
+      uint32_t arg2;
+      std::vector<uint8_t> payload;
+   } message;
+
+   bool __send_message__( const int fd, const uint32_t type, const uint32_t arg1, const uint32_t arg2, const std::vector<uint8_t> & payload ){
+
+      uint32_t header[ 4 ] = { htonl( type ), htonl( arg1 ), htonl( arg2 ), htonl( payload.size() ) };
+      std::vector<uint8_t> data( ( const uint8_t * )( header ), ( const uint8_t * )( header ) + sizeof( header ) );
+      data.insert( data.end(), payload.begin(), payload.end() );
+      size_t done = 0;
+      while ( done < data.size() ){
+         const ssize_t sent = send( fd, data.data() + done, data.size() - done, MSG_NOSIGNAL );
+         if ( sent <= 0 ){ return false; }
+         done += sent;
+      }
+      return true;
+
+   }
+
+   bool __recv_all__( const int fd, uint8_t * data, const size_t size ){
+
+      size_t done = 0;
+      while ( done < size ){
+         const ssize_t received = recv( fd, data + done, size - done, 0 );
+         if ( received <= 0 ){ return false; }
+         done += received;
+      }
+      return true;
+
+   }
+
+   bool __recv_message__( const int fd, message & msg ){
+
+      uint32_t header[ 4 ];
+      if ( __recv_all__( fd, ( uint8_t * )( header ), sizeof( header ) ) == false ){ return false; }
+      msg.type = ntohl( header[ 0 ] );
+      msg.arg1 = ntohl( header[ 1 ] );
+      msg.arg2 = ntohl( header[ 2 ] );
+      const uint32_t size = ntohl( header[ 3 ] );
+      if ( size > MAX_PAYLOAD ){ return false; } // The caller drops the connection
+      msg.payload.resize( size );
+      return __recv_all__( fd, msg.payload.data(), msg.payload.size() );
+
+   }
+
+}
+
+bool jans::sieve::set_coordinator( const int port ){
+
+   // Returns false if port cannot be listened on
+
+   assert( port > 0 );
+   listener = socket( AF_INET, SOCK_STREAM, 0 );
+   const int reuse = 1;
+   struct sockaddr_in address;
+   memset( &address, 0, sizeof( address ) );
+   address.sin_family      = AF_INET;
+   address.sin_addr.s_addr = htonl( INADDR_ANY );
+   address.sin_port        = htons( port );
+   if ( ( listener < 0 ) || ( setsockopt( listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof( reuse ) ) != 0 )
+     || ( bind( listener, ( struct sockaddr * )( &address ), sizeof( address ) ) != 0 ) || ( listen( listener, 16 ) != 0 ) ){
+      std::cerr << "   Error: cannot listen on port " << port << std::endl;
+      if ( listener >= 0 ){ close( listener ); }
+      listener = -1;
+      return false;
+   }
+   std::cout << "Coordinator listening on port " << port << "." << std::endl;
+   return true;
+
+}
+
+void jans::sieve::__coordinate__(){
+
+   std::vector<uint8_t> header;
+   __log_header__( header );
+
+   // Called again by run() while the excess does not suffice: the listener stays open, and the units continue at next_poly
+
+   std::mutex lock; // Guards the members below, shards[ 0 ] and found
+   ubase_t next_unit = next_poly;
+   std::vector<ubase_t> retry; // Units of disconnected workers
+   std::vector<int> clients;
+   std::unordered_set<uint64_t> seen;
+   for ( const smooth_number & sn : factorization ){ seen.insert( __relation_key__( sn ) ); }
+   for ( const smooth_number & sn : shards[ 0 ] ){ seen.insert( __relation_key__( sn ) ); }
+
+   std::vector<std::thread> threads;
+
+   while ( stop.load() == false ){
+
+      fd_set ready;
+      FD_ZERO( &ready );
+      FD_SET( listener, &ready );
+      struct timeval timeout = { 0, 100000 };
+      if ( select( listener + 1, &ready, NULL, NULL, &timeout ) <= 0 ){ continue; }
+      const int fd = accept( listener, NULL, NULL );
+      if ( fd < 0 ){ continue; }
+      {
+         std::lock_guard<std::mutex> guard( lock );
+         clients.push_back( fd );
+      }
+
+      threads.push_back( std::thread( [ &, fd ](){
+
+         message msg;
+         bool    busy = false; // Whether the worker holds a unit
+         ubase_t unit = 0;
+
+         bool ok = ( __recv_message__( fd, msg ) && ( msg.type == MSG_HELLO ) && ( msg.payload == header ) );
+         if ( ok == false ){
+            std::cerr << "   Error: a worker for another N, -K, -F or -M was refused" << std::endl;
+            __send_message__( fd, MSG_STOP, 1, 0, std::vector<uint8_t>() );
+         }
+
+         while ( ( ok ) && ( __recv_message__( fd, msg ) ) ){
+            if ( msg.type == MSG_REQUEST ){
+               std::unique_lock<std::mutex> guard( lock );
+               if ( stop.load() ){ break; }
+               if ( retry.empty() ){
+                  unit = next_unit;
+                  next_unit += WORK_UNIT;
+                  __open__( unit ); // Until its relations are logged, also while it waits in retry
+                  next_poly = next_unit;
+               } else {
+                  unit = retry.back();
+                  retry.pop_back();
+               }
+               busy = true;
+               guard.unlock();
+               ok = __send_message__( fd, MSG_WORK, unit, WORK_UNIT, std::vector<uint8_t>() );
+            } else if ( msg.type == MSG_RELATIONS ){
+               std::vector<smooth_number> received;
+               if ( __deserialize_relations__( msg.payload.data(), msg.payload.size(), msg.arg1, received ) == false ){ break; }
+               std::vector<smooth_number> accepted;
+               {
+                  std::lock_guard<std::mutex> guard( lock );
+                  busy = false;
+                  if ( stop.load() ){ break; }
+                  for ( smooth_number & sn : received ){
+                     if ( seen.insert( __relation_key__( sn ) ).second ){ accepted.push_back( std::move( sn ) ); }
+                  }
+                  __log__( accepted );
+                  __close__( unit );
+                  const int num_partial = std::count_if( accepted.begin(), accepted.end(), __is_partial__ );
+                  found    += accepted.size() - num_partial;
+                  partials += num_partial;
+                  {
+                     std::lock_guard<std::mutex> shard_lock( shard_locks[ 0 ] );
+                     for ( smooth_number & sn : accepted ){ shards[ 0 ].push_back( std::move( sn ) ); }
+                  }
+                  std::cout << "Obtained / required B-smooth numbers = " << found.load() << " / " << required << "." << std::endl;
+                  if ( found.load() >= required ){ stop = true; }
+               }
+               __check_excess__(); // Filters without holding lock, so that the other workers are served meanwhile
+            } else {
+               break;
+            }
+         }
+
+         std::lock_guard<std::mutex> guard( lock );
+         if ( ( busy ) && ( stop.load() == false ) ){ retry.push_back( unit ); }
+         if ( stop.load() ){ __send_message__( fd, MSG_STOP, 0, 0, std::vector<uint8_t>() ); }
+         for ( size_t i = 0; i < clients.size(); i++ ){
+            if ( clients[ i ] == fd ){ clients.erase( clients.begin() + i ); break; }
+         }
+         close( fd );
+
+      } ) );
+   }
+
+   {
+      // Workers which are still sieving notice the closed connection when returning their unit
+      std::lock_guard<std::mutex> guard( lock );
+      for ( const int fd : clients ){ shutdown( fd, SHUT_RDWR ); }
+   }
+   for ( std::thread & thread : threads ){ thread.join(); }
+
+}
+
+bool jans::sieve::work( const std::string & host, const int port, const double threshold ){
+
+   // Sieves the work units of the coordinator at host:port until it has sufficient relations
+   // Returns false if the coordinator cannot be reached or refuses this worker
+
+   struct addrinfo hints;
+   struct addrinfo * result = NULL;
+   memset( &hints, 0, sizeof( hints ) );
+   hints.ai_family   = AF_UNSPEC;
+   hints.ai_socktype = SOCK_STREAM;
+   int fd = -1;
+   if ( getaddrinfo( host.c_str(), std::to_string( port ).c_str(), &hints, &result ) == 0 ){
+      for ( struct addrinfo * info = result; ( info != NULL ) && ( fd < 0 ); info = info->ai_next ){
+         fd = socket( info->ai_family, info->ai_socktype, info->ai_protocol );
+         if ( ( fd >= 0 ) && ( connect( fd, info->ai_addr, info->ai_addrlen ) != 0 ) ){
+            close( fd );
+            fd = -1;
+         }
+      }
+      freeaddrinfo( result );
+   }
+   if ( fd < 0 ){
+      std::cerr << "   Error: cannot connect to the coordinator at " << host << ":" << port << std::endl;
+      return false;
+   }
+
+   std::vector<uint8_t> header;
+   __log_header__( header );
+   __startup1__( mpqs_q0 );
+   control.reset( threshold, adaptive );
+
+   message msg;
+   msg.type  = 0;
+   int units = 0;
+   int sent  = 0;
+   bool ok = __send_message__( fd, MSG_HELLO, 0, 0, header );
+   while ( ( ok ) && ( __send_message__( fd, MSG_REQUEST, 0, 0, std::vector<uint8_t>() ) ) && ( __recv_message__( fd, msg ) ) && ( msg.type == MSG_WORK ) ){
+
+      next_poly   = msg.arg1;
+      last_poly   = msg.arg1 + msg.arg2;
+      found       = 0;
+      partials    = 0;
+      next_filter = INT_MAX; // The coordinator filters
+      stop        = false;
+      __sieve__();
+
+      std::vector<smooth_number> relations;
+      for ( int shard = 0; shard < num_shards; shard++ ){
+         for ( smooth_number & sn : shards[ shard ] ){ relations.push_back( std::move( sn ) ); }
+         shards[ shard ].clear();
+      }
+      std::vector<uint8_t> payload;
+      __serialize_relations__( payload, relations );
+      ok = __send_message__( fd, MSG_RELATIONS, relations.size(), 0, payload );
+      if ( ok ){
+         units++;
+         sent += relations.size();
+      }
+   }
+   close( fd );
+
+   const bool refused = ( ( msg.type == MSG_STOP ) && ( msg.arg1 == 1 ) );
+   if ( refused ){ std::cerr << "   Error: the coordinator sieves another N, -K, -F or -M" << std::endl; }
+   std::cout << "Worker sieved " << units << " work units and sent " << sent << " relations." << std::endl;
+   return ( refused == false );
+
+}
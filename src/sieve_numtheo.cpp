@@ -20,6 +20,7 @@
 #include <assert.h>
 
 #include "sieve.h"
+#include "cofactor/cofactor.h"
 
 int jans::sieve::__legendre_symbol__( jans::big_int & num, const ubase_t p ){
 
@@ -115,11 +116,45 @@ bool jans::sieve::__extract__( big_int & x, ubase_t * helper ) const{
 
 }
 
+bool jans::sieve::__large_primes__( big_int & x, uint32_t * large ) const{
+
+   // Cofactor x left by __extract__: returns true if it is one prime or the product of two primes up to large_bound,
+   // which are stored in large[ 0 : 2 ] ( 1 if absent ) for a partial relation
+
+   ucarry_t cofactor;
+   if ( jans::big_int::i2u( x, cofactor ) == false ){ return false; }
+   if ( cofactor < 2 ){ return false; }
+   const ucarry_t bound = large_bound;
+   if ( cofactor / bound > bound ){ return false; } // Above large_bound^2
+   large[ 0 ] = 1;
+   large[ 1 ] = 1;
+   if ( jans::cofactor::is_prime( cofactor ) ){
+      if ( cofactor > bound ){ return false; }
+      large[ 0 ] = cofactor;
+      return true;
+   }
+   const ucarry_t factor = jans::cofactor::split( cofactor );
+   const ucarry_t other  = cofactor / factor;
+   if ( ( factor > bound ) || ( other > bound ) ){ return false; }
+   if ( ( jans::cofactor::is_prime( factor ) == false ) || ( jans::cofactor::is_prime( other ) == false ) ){ return false; }
+   large[ 0 ] = ( ( factor < other ) ? factor : other );
+   large[ 1 ] = ( ( factor < other ) ? other : factor );
+   return true;
+
+}
+
 ubase_t jans::sieve::__inv_x_mod_p__( jans::big_int & x, const ubase_t p ){
 
    jans::big_int quot;
    const ubase_t rem = jans::big_int::div( quot, x, p ); // rem = x % p
    assert( jans::big_int::equal( quot, 0 ) == false );
+   return __inv_x_mod_p__( rem, p );
+
+}
+
+ubase_t jans::sieve::__inv_x_mod_p__( const ubase_t x, const ubase_t p ){
+
+   const ubase_t rem = x % p;
 
    int     a = 0;   // a = u_ini = 0
    ubase_t g = p;   // g = w_ini = p
@@ -144,6 +179,26 @@ ubase_t jans::sieve::__inv_x_mod_p__( jans::big_int & x, const ubase_t p ){
 
 }
 
+ubase_t jans::sieve::__hensel_lift__( const ubase_t root, jans::big_int & num, const ubase_t p, const ubase_t pe ){
+
+   /*
+    *   Hensel: root^2 = num mod ( pe / p ) with p odd and p not dividing num
+    *       --> lift = root - ( root^2 - num ) / ( 2 * root ) satisfies lift^2 = num mod pe
+    */
+
+   jans::big_int work;
+   const ucarry_t num_pe = jans::big_int::div( work, num, pe );
+   const ucarry_t r      = root % pe;
+   const ucarry_t f_r    = ( ( ( r * r ) % pe ) + pe - num_pe ) % pe;
+   const ucarry_t inv    = __inv_x_mod_p__( ( ubase_t )( ( 2 * r ) % pe ), pe );
+   const ucarry_t corr   = ( f_r * inv ) % pe;
+   const ubase_t  lift   = ( r + pe - corr ) % pe;
+   assert( ( ( ( ( ucarry_t ) lift ) * lift ) % pe ) == num_pe );
+   assert( lift % p == root % p );
+   return lift;
+
+}
+
 ubase_t jans::sieve::__root_quadratic_residue__( jans::big_int & num, const ubase_t p ){
 
    jans::big_int work;
@@ -0,0 +1,203 @@
+/*
+   JANS: just another number sieve
+   Copyright (C) 2018 Sebastian Wouters
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+#include <assert.h>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "sieve.h"
+#include "bounded_queue.h"
+
+namespace{
+
+   typedef struct
+   {
+      jans::big_int a;
+      jans::big_int b;
+      jans::big_int mpqs_q;
+      ubase_t poly;
+      double  threshold;
+      double  seconds; // Spent on the job by the generation and sieving stages
+      std::vector<ubase_t> shift1; // Also the trial division helper of the checking stage
+      std::vector<ubase_t> shift2;
+      std::vector<double>  sumlog;
+   } sieve_job;
+
+   template <typename T>
+   bool __wait_pop__( jans::bounded_queue<T> & queue, T & item, std::atomic<bool> & stop, std::atomic<int> & producers ){
+
+      // Returns false if sufficient relations were found while waiting, or if all producers of the queue
+      // finished ( the polynomial range ran out ) and the queue is drained
+
+      while ( queue.try_pop( item ) == false ){
+         if ( stop.load( std::memory_order_relaxed ) ){ return false; }
+         if ( producers.load() == 0 ){ return queue.try_pop( item ); }
+         std::this_thread::yield();
+      }
+      return true;
+
+   }
+
+}
+
+void jans::sieve::__sieve_pipeline__(){
+
+   /*
+    *   Dedicated stages, connected by bounded lock-free queues:
+    *      generators: __next_polynomial__ & __calculate_shifts__   empty     --> generated
+    *      sievers   : __sieve_sumlog__                             generated --> sieved
+    *      checkers  : __check_sumlog__ & __log__                   sieved    --> empty & relations
+    *      store     : relations to the shards (calling thread)     relations -->
+    *   The number of jobs in flight is bounded, and so is the memory.
+    */
+
+   const int num_gen   = pipeline[ 0 ];
+   const int num_sieve = pipeline[ 1 ];
+   const int num_check = pipeline[ 2 ];
+   const int num_jobs  = 2 * ( num_gen + num_sieve + num_check );
+
+   const ubase_t size = 2 * M + 1;
+
+   sieve_job * jobs = new sieve_job[ num_jobs ];
+   jans::bounded_queue<sieve_job *> empty( num_jobs );
+   jans::bounded_queue<sieve_job *> generated( num_jobs );
+   jans::bounded_queue<sieve_job *> sieved( num_jobs );
+   jans::bounded_queue<std::vector<smooth_number> *> relations( num_jobs );
+
+   for ( int job = 0; job < num_jobs; job++ ){
+      jobs[ job ].shift1.resize( num_primes + num_powers );
+      jobs[ job ].shift2.resize( num_primes + num_powers );
+      jobs[ job ].sumlog.resize( size );
+      const bool ok = empty.try_push( &jobs[ job ] );
+      assert( ok );
+   }
+
+   // Running threads per stage: a stage finishes when its upstream stage finished and its queue is drained
+   std::atomic<int> generators_running;
+   std::atomic<int> sievers_running;
+   std::atomic<int> checkers_running;
+   generators_running = num_gen;
+   sievers_running    = num_sieve;
+   checkers_running   = num_check;
+
+   std::vector<std::thread> threads;
+
+   for ( int thread = 0; thread < num_gen; thread++ ){
+      threads.push_back( std::thread( [ & ](){
+         ubase_t poly     = 0;
+         ubase_t poly_end = 0;
+         sieve_job * job;
+         while ( __wait_pop__( empty, job, stop, checkers_running ) ){
+            const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+            if ( __next_polynomial__( job->a, job->b, job->mpqs_q, poly, poly_end ) == false ){ break; }
+            job->poly      = poly - 1;
+            __open__( job->poly ); // Closed by the checker once its relations are logged
+            job->threshold = control.threshold( job->poly );
+            __calculate_shifts__( job->shift1.data(), job->shift2.data(), job->a, job->b );
+            const std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - begin;
+            job->seconds   = seconds.count();
+            const bool ok = generated.try_push( job ); // Never full: capacity >= num_jobs
+            assert( ok );
+         }
+         generators_running--;
+      } ) );
+   }
+
+   for ( int thread = 0; thread < num_sieve; thread++ ){
+      threads.push_back( std::thread( [ & ](){
+         sieve_job * job;
+         while ( __wait_pop__( generated, job, stop, generators_running ) ){
+            const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+            const bool sieved_ok = __sieve_sumlog__( 0, size, job->sumlog.data(), job->shift1.data(), job->shift2.data() );
+            const std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - begin;
+            job->seconds += seconds.count();
+            const bool ok = ( ( sieved_ok ) ? sieved.try_push( job ) : empty.try_push( job ) );
+            assert( ok );
+         }
+         sievers_running--;
+      } ) );
+   }
+
+   for ( int thread = 0; thread < num_check; thread++ ){
+      threads.push_back( std::thread( [ & ](){
+         sieve_job * job;
+         std::vector<survivor> batch;
+         std::vector<ubase_t>  shift_helper( num_primes );
+         std::vector<ubase_t>  opened; // Polynomials checked by this thread, but not closed yet
+         while ( __wait_pop__( sieved, job, stop, sievers_running ) ){
+            const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+            sieve_stats stats = {};
+            std::vector<smooth_number> * buffer = new std::vector<smooth_number>();
+            __check_sumlog__( 0, size, job->sumlog.data(), job->shift1.data(), job->threshold, job->a, job->b, job->poly, stats, *buffer, batch );
+            opened.push_back( job->poly );
+            __report__( job->mpqs_q, stats, false );
+            if ( adaptive ){ // The update takes the lock of the controller
+               const std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - begin;
+               control.update( job->threshold, stats.survivors, stats.smooths, job->seconds + seconds.count(), stats.seconds_extract );
+            }
+            const bool ok = empty.try_push( job );
+            assert( ok );
+            __log__( *buffer ); // Here rather than in the store, so that the polynomials can be closed
+            __close__( opened, batch );
+            if ( buffer->empty() ){
+               delete buffer;
+            } else {
+               while ( relations.try_push( buffer ) == false ){ std::this_thread::yield(); } // The store thread drains until all checkers are done
+            }
+         }
+         if ( ( batch.empty() == false ) && ( stop.load() == false ) ){ // The polynomial range ran out
+            sieve_stats stats = {};
+            std::vector<smooth_number> * buffer = new std::vector<smooth_number>();
+            __extract_batch__( batch, shift_helper.data(), stats, *buffer );
+            __log__( *buffer );
+            __close__( opened, batch );
+            while ( relations.try_push( buffer ) == false ){ std::this_thread::yield(); }
+         }
+         checkers_running--;
+      } ) );
+   }
+
+   // Relation store: only this thread appends to shard 0 while the stages run
+   while ( true ){
+      std::vector<smooth_number> * buffer;
+      if ( relations.try_pop( buffer ) ){
+         {
+            std::lock_guard<std::mutex> lock( shard_locks[ 0 ] );
+            for ( smooth_number & sn : *buffer ){ shards[ 0 ].push_back( std::move( sn ) ); }
+         }
+         delete buffer;
+         if ( quiet == false ){
+            std::cout << "Obtained / required B-smooth numbers = " << found.load() << " / " << required << "." << std::endl;
+         }
+         __check_excess__();
+      } else {
+         if ( checkers_running.load() == 0 ){ break; }
+         std::this_thread::yield();
+      }
+   }
+
+   for ( std::thread & thread : threads ){ thread.join(); }
+
+   delete [] jobs;
+
+}
+
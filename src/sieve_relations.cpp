@@ -0,0 +1,310 @@
+/*
+   JANS: just another number sieve
+   Copyright (C) 2018 Sebastian Wouters
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+#include <assert.h>
+#include <limits.h>
+#include <iostream>
+#include <algorithm>
+#include <map>
+#include <unordered_set>
+#include <vector>
+
+#include "sieve.h"
+
+/*
+    Relations are stored compactly: the polynomial index and the sieve offset x instead of xval and pval,
+    and the prime factors as LEB128 varints. Each factor is one value ( index delta << 1 | power > 1 ),
+    followed by the power if it is larger than one. Most factors hence take a single byte. A partial relation
+    also has one or two large primes, i.e. primes above the factor base which do not go into factors.
+*/
+
+namespace{
+
+   void __put_varint__( std::vector<uint8_t> & out, uint32_t value ){
+
+      while ( value >= 0x80U ){
+         out.push_back( ( uint8_t )( value | 0x80U ) );
+         value = value >> 7;
+      }
+      out.push_back( ( uint8_t )( value ) );
+
+   }
+
+   bool __get_varint__( const uint8_t * in, const size_t size, size_t & pos, uint32_t & value ){
+
+      // Returns false if in[ pos : size ] does not start with a complete varint
+
+      value = 0;
+      for ( int shift = 0; ( shift < 35 ) && ( pos < size ); shift += 7 ){
+         value = value | ( ( uint32_t )( in[ pos ] & 0x7FU ) << shift );
+         if ( ( in[ pos++ ] & 0x80U ) == 0 ){ return true; }
+      }
+      return false;
+
+   }
+
+}
+
+jans::smooth_number jans::__pack_smooth_number__(const bool negative, const uint32_t poly, const int32_t x, ubase_t * powers, const ubase_t num_primes, const uint32_t * large)
+{
+    // large[ 0 : 2 ] are the large primes of a partial relation ( 1 if absent ), or NULL for a full relation
+
+    jans::smooth_number result;
+    result.poly = poly;
+    result.x = x;
+    result.negative = negative;
+    result.large[0] = ((large == NULL) ? 1U : large[0]);
+    result.large[1] = ((large == NULL) ? 1U : large[1]);
+    uint32_t previous = 0;
+    for (ubase_t ip = 0; ip < num_primes; ++ip)
+    {
+        if (powers[ip] != 0)
+        {
+            const uint32_t delta = ip - previous;
+            assert(delta < (1U << 31));
+            __put_varint__(result.factors, (delta << 1) | ((powers[ip] > 1) ? 1U : 0U));
+            if (powers[ip] > 1)
+            {
+                __put_varint__(result.factors, powers[ip]);
+            }
+            previous = ip;
+        }
+    }
+    result.factors.shrink_to_fit();
+    return result;
+}
+
+void jans::__unpack_factors__(const jans::smooth_number& sn, std::vector<jans::prime_factor>& factors)
+{
+    factors.clear();
+    uint32_t index = 0;
+    size_t pos = 0;
+    uint32_t value;
+    uint32_t power = 1;
+    while (__get_varint__(sn.factors.data(), sn.factors.size(), pos, value))
+    {
+        index += value >> 1;
+        if ((value & 1U) && (__get_varint__(sn.factors.data(), sn.factors.size(), pos, power) == false))
+        {
+            break;
+        }
+        factors.push_back({index, ((value & 1U) ? power : 1U)});
+    }
+}
+
+void jans::__serialize_relations__(std::vector<uint8_t>& out, const std::vector<jans::smooth_number>& list)
+{
+    // Per relation: varint poly, varint zigzag( x ), byte ( number of large primes << 1 | sign ), varint large primes,
+    // varint number of bytes, varint coded factors ( a full relation is hence stored as before partial relations existed )
+    for (const smooth_number& sn : list)
+    {
+        const uint32_t num_large = (sn.large[0] > 1U) + (sn.large[1] > 1U);
+        __put_varint__(out, sn.poly);
+        __put_varint__(out, (((uint32_t) sn.x) << 1) ^ ((uint32_t)(sn.x >> 31)));
+        out.push_back((uint8_t)((num_large << 1) | (sn.negative ? 1U : 0U)));
+        for (uint32_t cnt = 0; cnt < num_large; ++cnt)
+        {
+            __put_varint__(out, sn.large[cnt]);
+        }
+        __put_varint__(out, sn.factors.size());
+        out.insert(out.end(), sn.factors.begin(), sn.factors.end());
+    }
+}
+
+bool jans::__deserialize_relations__(const uint8_t * data, const size_t size, const uint32_t count, std::vector<jans::smooth_number>& list)
+{
+    // Returns false if data[ 0 : size ] does not contain exactly count relations
+
+    size_t pos = 0;
+    for (uint32_t cnt = 0; cnt < count; ++cnt)
+    {
+        jans::smooth_number sn;
+        uint32_t value;
+        if (__get_varint__(data, size, pos, sn.poly) == false) { return false; }
+        if (__get_varint__(data, size, pos, value) == false) { return false; }
+        sn.x = (int32_t)((value >> 1) ^ (0U - (value & 1U)));
+        if (pos >= size) { return false; }
+        const uint8_t flags = data[pos++];
+        if (flags > 5U) { return false; }
+        sn.negative = ((flags & 1U) != 0);
+        sn.large[0] = 1U;
+        sn.large[1] = 1U;
+        for (uint32_t cnt = 0; cnt < (uint32_t)(flags >> 1); ++cnt)
+        {
+            if (__get_varint__(data, size, pos, sn.large[cnt]) == false) { return false; }
+            if (sn.large[cnt] < 2U) { return false; }
+        }
+        if (__get_varint__(data, size, pos, value) == false) { return false; }
+        if (value > size - pos) { return false; }
+        sn.factors.assign(data + pos, data + pos + value);
+        pos += value;
+        list.push_back(std::move(sn));
+    }
+    return (pos == size);
+}
+
+void jans::sieve::__polynomial__( jans::big_int & a, jans::big_int & b, jans::big_int & mpqs_q, const ubase_t poly ){
+
+   // Recomputes a, b and mpqs_q of a polynomial index which was handed out during sieving
+
+   __mpqs_q__( mpqs_q, poly );
+   const bool valid = __check_mpqs_q__( a, b, mpqs_q );
+   assert( valid );
+
+}
+
+void jans::sieve::__collect_relations__(){
+
+   // Moves the relations of all shards to factorization, without duplicate ( poly, x ) pairs
+   // If verify, the new relations are checked in parallel and the bad ones are dropped
+   // Sets found and partials to the number of full and partial relations in factorization
+
+   const size_t previous = factorization.size(); // Distinct and verified
+   std::unordered_set<uint64_t> seen;
+   for ( const smooth_number & sn : factorization ){ seen.insert( __relation_key__( sn ) ); }
+
+   int duplicates = 0;
+   for ( int shard = 0; shard < num_shards; shard++ ){
+      for ( smooth_number & sn : shards[ shard ] ){
+         if ( seen.insert( __relation_key__( sn ) ).second ){ factorization.push_back( std::move( sn ) ); }
+                                                       else { duplicates++; }
+      }
+      std::vector<smooth_number>().swap( shards[ shard ] );
+   }
+   if ( duplicates > 0 ){ std::cout << "Dropped " << duplicates << " duplicate relations." << std::endl; }
+
+   if ( verify ){
+      const int num = factorization.size() - previous;
+      std::vector<char> good( num );
+      #pragma omp parallel
+      {
+         std::map<uint32_t, std::vector<jans::big_int>> polynomials; // poly --> { a, b, mpqs_q }
+         #pragma omp for schedule(dynamic, 16)
+         for ( int i = 0; i < num; i++ ){
+            const smooth_number & sn = factorization[ previous + i ];
+            std::map<uint32_t, std::vector<jans::big_int>>::iterator it = polynomials.find( sn.poly );
+            if ( it == polynomials.end() ){
+               std::vector<jans::big_int> abq( 3 );
+               __polynomial__( abq[ 0 ], abq[ 1 ], abq[ 2 ], sn.poly );
+               it = polynomials.emplace( sn.poly, abq ).first;
+            }
+            good[ i ] = __verify_relation__( sn, it->second[ 0 ], it->second[ 1 ] );
+         }
+      }
+      size_t kept = previous;
+      for ( int i = 0; i < num; i++ ){
+         if ( good[ i ] ){
+            if ( kept != previous + i ){ factorization[ kept ] = std::move( factorization[ previous + i ] ); }
+            kept++;
+         }
+      }
+      std::cout << "Verified " << num << " relations: dropped " << previous + num - kept << " bad relations." << std::endl;
+      factorization.resize( kept );
+   }
+
+   const int num_partial = std::count_if( factorization.begin(), factorization.end(), __is_partial__ );
+   found    = factorization.size() - num_partial;
+   partials = num_partial;
+
+}
+
+bool jans::sieve::__verify_relation__( const smooth_number & sn, jans::big_int & a, jans::big_int & b ){
+
+   // ( a * x + b )^2 - kN = a * Q(x): recompute Q(x) and compare with the stored sign, prime factors and large primes
+
+   if ( ( sn.x < -( int32_t )( M ) ) || ( sn.x > ( int32_t )( M ) ) ){ return false; }
+
+   jans::big_int work1;
+   jans::big_int work2;
+   jans::big_int value;
+   jans::big_int rem;
+
+   const ubase_t abs_x = ( ( sn.x < 0 ) ? -sn.x : sn.x );
+   jans::big_int::prod( work1, a, abs_x );
+   if ( sn.x < 0 ){ jans::big_int::diff( work1, work1, b ); }
+              else { jans::big_int::sum(  work1, work1, b ); }
+   jans::big_int::prod( work2, work1, work1 );
+   const bool negative = jans::big_int::smaller( work2, target );
+   if ( negative ){ jans::big_int::diff( work1, target, work2 ); }
+             else { jans::big_int::diff( work1, work2, target ); }
+   jans::big_int::div( value, rem, work1, a ); // value = abs( Q(x) )
+   if ( ( negative != sn.negative ) || ( jans::big_int::equal( rem, 0 ) == false ) ){ return false; }
+
+   // work1 = product of the stored prime factors
+   std::vector<prime_factor> factors;
+   __unpack_factors__( sn, factors );
+   work1.copy( 1 );
+   for ( const prime_factor & pf : factors ){
+      if ( pf.index >= ( uint32_t )( num_primes ) ){ return false; }
+      for ( uint32_t pow = 0; pow < pf.power; pow++ ){
+         jans::big_int::prod( work2, work1, primes[ pf.index ] );
+         work1.copy( work2 );
+         if ( jans::big_int::smaller( value, work1 ) ){ return false; }
+      }
+   }
+   for ( const uint32_t large : sn.large ){ // 1 if absent
+      jans::big_int::prod( work2, work1, large );
+      work1.copy( work2 );
+   }
+   return jans::big_int::equal( value, work1 );
+
+}
+
+int jans::sieve::__excess__(){
+
+   // Number of relations minus number of active primes ( and sign, and large primes ), after iterative singleton removal
+   // Safe while sieving: reads the shards under their locks
+
+   std::unordered_map<uint32_t, uint32_t> large_columns;
+   std::vector<std::vector<uint32_t>> space = __gf2sparse__( factorization, num_primes, large_columns );
+   for ( int shard = 0; shard < num_shards; shard++ ){
+      std::lock_guard<std::mutex> lock( shard_locks[ shard ] );
+      std::vector<std::vector<uint32_t>> part = __gf2sparse__( shards[ shard ], num_primes, large_columns );
+      for ( std::vector<uint32_t> & row : part ){ space.push_back( std::move( row ) ); }
+   }
+
+   uint32_t num_active = 0;
+   const std::vector<uint32_t> relevant = jans::gf2solver::remove_singletons( space, 1 + num_primes + large_columns.size(), num_active );
+   return ( ( int )( relevant.size() ) - ( int )( num_active ) );
+
+}
+
+void jans::sieve::__check_excess__(){
+
+   // Called after relations were stored: once found + partials reaches next_filter, the relations are filtered
+   // by one thread and sieving stops if the excess suffices
+
+   if ( found.load() + partials.load() < next_filter.load() ){ return; }
+   std::unique_lock<std::mutex> guard( filter_mutex, std::try_to_lock );
+   if ( guard.owns_lock() == false ){ return; }
+   if ( found.load() + partials.load() < next_filter.load() ){ return; }
+
+   const int total  = found.load() + partials.load();
+   const int excess = __excess__();
+   std::cout << "Filtered excess = " + std::to_string( excess ) + " / " + std::to_string( extra ) + " for " + std::to_string( total ) + " relations.\n";
+   if ( excess >= extra ){
+      stop        = true;
+      next_filter = INT_MAX;
+   } else {
+      const int step = std::max( extra - excess, required / 50 ); // Every relation increases the excess by at most one
+      next_filter = total + step;
+   }
+
+}
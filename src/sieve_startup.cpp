@@ -19,6 +19,7 @@
 
 #include <assert.h>
 #include <math.h>
+#include <vector>
 
 #include "sieve.h"
 
@@ -37,6 +38,13 @@ void jans::sieve::__startup1__( jans::big_int & mpqs_q ){
 
 }
 
+void jans::sieve::__mpqs_q__( jans::big_int & mpqs_q, const ubase_t poly ){
+
+   assert( poly < ( __11111111__ / 4 ) );
+   jans::big_int::diff( mpqs_q, mpqs_q0, 4 * ( poly + 1 ) ); // mpqs_q % 4 = 3 as mpqs_q0 % 4 = 3
+
+}
+
 void jans::sieve::__startup2__( const ubase_t bound ){
 
    /*
@@ -53,7 +61,7 @@ void jans::sieve::__startup2__( const ubase_t bound ){
    for ( ubase_t cnt = 1; cnt <= cntmax; cnt++ ){
       if ( helper[ cnt ] == 1 ){
          const ubase_t number = 2 * cnt + 1;
-         const bool    ok     = ( __legendre_symbol__( target, number ) == 1 );
+         const bool    ok     = ( ( __legendre_symbol__( target, number ) == 1 ) || ( multiplier % number == 0 ) ); // p | k: root 0
          const ubase_t start  = ( ( ok ) ? 3 : 1 );
          const ubase_t stop   = bound / number;
          if ( ok ){ num_primes++; }
@@ -77,7 +85,7 @@ void jans::sieve::__startup2__( const ubase_t bound ){
    for ( ubase_t cnt = 1; cnt <= cntmax; cnt++ ){
       if ( helper[ cnt ] == 1 ){
          const ubase_t number = 2 * cnt + 1;
-         const ubase_t a      = __root_quadratic_residue__( target, number );
+         const ubase_t a      = ( ( multiplier % number == 0 ) ? 0 : __root_quadratic_residue__( target, number ) );
               primes[ check ] = number;
                roots[ check ] = a;
               logval[ check ] = log( ( double ) number );
@@ -88,5 +96,46 @@ void jans::sieve::__startup2__( const ubase_t bound ){
 
    delete [] helper;
 
+   /*
+    *   Prime powers p^e <= bound for odd p not dividing k: roots lifted with Hensel's lemma from roots[ ip ].
+    *   Each hit adds another log( p ), so that the sieve value estimates log( Q(x) ) including the powers.
+    */
+
+   std::vector<ubase_t> pow_primes;
+   std::vector<ubase_t> pow_roots;
+   std::vector<double>  pow_logval;
+
+   for ( int ip = 1; ip < num_primes; ip++ ){
+      if ( roots[ ip ] == 0 ){ continue; }
+      const ubase_t p    = primes[ ip ];
+            ubase_t root = roots[ ip ];
+      for ( ucarry_t pe = ( ( ucarry_t ) p ) * p; pe <= bound; pe *= p ){
+         root = __hensel_lift__( root, target, p, pe );
+         pow_primes.push_back( pe );
+         pow_roots.push_back( root );
+         pow_logval.push_back( logval[ ip ] );
+      }
+   }
+
+   num_powers = pow_primes.size();
+   if ( num_powers > 0 ){
+      ubase_t * all_primes = new ubase_t[ num_primes + num_powers ];
+      ubase_t * all_roots  = new ubase_t[ num_primes + num_powers ];
+      double  * all_logval = new  double[ num_primes + num_powers ];
+      for ( int ip = 0; ip < num_primes; ip++ ){
+         all_primes[ ip ] = primes[ ip ];
+          all_roots[ ip ] =  roots[ ip ];
+         all_logval[ ip ] = logval[ ip ];
+      }
+      for ( int ie = 0; ie < num_powers; ie++ ){
+         all_primes[ num_primes + ie ] = pow_primes[ ie ];
+          all_roots[ num_primes + ie ] =  pow_roots[ ie ];
+         all_logval[ num_primes + ie ] = pow_logval[ ie ];
+      }
+      delete [] primes; primes = all_primes;
+      delete []  roots;  roots = all_roots;
+      delete [] logval; logval = all_logval;
+   }
+
 }
 
@@ -0,0 +1,132 @@
+/*
+   JANS: just another number sieve
+   Copyright (C) 2018-2020 Sebastian Wouters
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include <math.h>
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+#include "threshold_controller.h"
+
+#define EXPLORE_EVERY 4  // Every fourth polynomial is an exploration polynomial
+#define ADAPT_EVERY   16 // Polynomials between two adaptations of T
+#define MIN_OBSERVED  4  // Bins seen on fewer polynomials are not trusted
+
+jans::threshold_controller::threshold_controller()
+{
+    reset(8.0, false);
+}
+
+void jans::threshold_controller::reset(const double initial, const bool adaptive)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    this->adaptive  = adaptive;
+    current         = initial;
+    explore         = 4 * THRESHOLD_STEP;
+    polys           = 0U;
+    seconds_fixed   = 0.0;
+    seconds_extract = 0.0;
+    observed.assign(THRESHOLD_BINS, 0U);
+    survivors.assign(THRESHOLD_BINS, 0U);
+    smooth.assign(THRESHOLD_BINS, 0U);
+}
+
+/*
+    Threshold for polynomial index poly
+*/
+double jans::threshold_controller::threshold(const uint32_t poly) const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (adaptive && (poly % EXPLORE_EVERY == 0U))
+    {
+        return std::min(current + explore, (THRESHOLD_BINS - 1) * THRESHOLD_STEP);
+    }
+    return current;
+}
+
+int jans::threshold_controller::bin(const double deficit)
+{
+    if (deficit <= 0.0){ return 0; }
+    const int result = 1 + (int)(floor(deficit / THRESHOLD_STEP));
+    return std::min(result, THRESHOLD_BINS - 1);
+}
+
+/*
+    Account for one polynomial which was checked with threshold used
+*/
+void jans::threshold_controller::update(const double used, const int * survivors, const int * smooth, const double seconds_total, const double seconds_extract)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    ++polys;
+    this->seconds_fixed   += std::max(seconds_total - seconds_extract, 0.0);
+    this->seconds_extract += seconds_extract;
+    for (int b = 0; b < THRESHOLD_BINS; ++b)
+    {
+        if (b * THRESHOLD_STEP <= used){ ++observed[b]; }
+        this->survivors[b] += survivors[b];
+        this->smooth[b]    += smooth[b];
+    }
+    if (adaptive && (polys % ADAPT_EVERY == 0U))
+    {
+        adapt();
+    }
+}
+
+void jans::threshold_controller::adapt()
+{
+    uint64_t total_survivors = 0U;
+    for (int b = 0; b < THRESHOLD_BINS; ++b){ total_survivors += survivors[b]; }
+    if (total_survivors == 0U){ return; }
+    const double per_survivor = seconds_extract / total_survivors;
+    const double fixed        = seconds_fixed / polys;
+
+    double best_rate = 0.0;
+    int    best_bin  = -1;
+    double cum_surv  = 0.0;
+    double cum_smth  = 0.0;
+    for (int b = 0; (b < THRESHOLD_BINS) && (observed[b] >= MIN_OBSERVED); ++b)
+    {
+        cum_surv += (double)(survivors[b]) / observed[b];
+        cum_smth += (double)(smooth[b])    / observed[b];
+        const double rate = cum_smth / (fixed + per_survivor * cum_surv);
+        if (rate > best_rate)
+        {
+            best_rate = rate;
+            best_bin  = b;
+        }
+    }
+    if (best_bin > 0)
+    {
+        current = best_bin * THRESHOLD_STEP; // Upper edge of the bin
+    }
+}
+
+void jans::threshold_controller::report() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    std::ostringstream message;
+    message << "Threshold T = " << current << " after " << polys << " polynomials." << std::endl;
+    message << "Per polynomial, by deficit = log( abs( Q(x) ) ) - sumlog: survivors | smooth" << std::endl;
+    for (int b = 0; b < THRESHOLD_BINS; ++b)
+    {
+        if ((observed[b] == 0U) || (survivors[b] == 0U)){ continue; }
+        message << "   deficit <= " << b * THRESHOLD_STEP << " : " << (double)(survivors[b]) / observed[b] << " | " << (double)(smooth[b]) / observed[b] << std::endl;
+    }
+    std::cout << message.str();
+}
@@ -0,0 +1,81 @@
+/*
+   JANS: just another number sieve
+   Copyright (C) 2018-2020 Sebastian Wouters
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+#pragma once
+
+#include <mutex>
+#include <stdint.h>
+#include <vector>
+
+#define THRESHOLD_BINS 64   // Histogram bins of deficit = log( abs( Q(x) ) ) - sumlog
+#define THRESHOLD_STEP 0.5  // Bin b > 0 covers deficit in ( ( b - 1 ) * STEP, b * STEP ], bin 0 deficit <= 0
+
+namespace jans {
+
+    /*
+        Online choice of the sieve threshold T: x survives the sieve if its deficit < T.
+          - per deficit bin, the survivors and smooth numbers per polynomial are tracked
+          - bins beyond T are only seen on exploration polynomials (every fourth), sieved with T + explore,
+            hence the counts are normalized by the number of polynomials which observed the bin
+          - every few polynomials, T is set to the bin edge which maximizes
+            smooth(T) / ( seconds_fixed + seconds_per_survivor * survivors(T) ) per polynomial
+        Thread safe. Without adaptivity, threshold() always returns the initial T.
+     */
+    class threshold_controller
+    {
+        public:
+
+            threshold_controller();
+
+            void reset(const double initial, const bool adaptive);
+
+            double threshold(const uint32_t poly) const;
+
+            static int bin(const double deficit);
+
+            void update(const double used, const int * survivors, const int * smooth, const double seconds_total, const double seconds_extract);
+
+            void report() const;
+
+        private:
+
+            mutable std::mutex lock;
+
+            bool adaptive;
+
+            double current; // T
+
+            double explore; // Extra threshold on exploration polynomials
+
+            uint32_t polys;
+
+            double seconds_fixed; // Total time minus the time spent on survivors
+
+            double seconds_extract; // Time spent on survivors
+
+            std::vector<uint64_t> observed; // Per bin: number of polynomials sieved with a threshold covering the bin
+
+            std::vector<uint64_t> survivors;
+
+            std::vector<uint64_t> smooth;
+
+            void adapt();
+    };
+}